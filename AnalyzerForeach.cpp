@@ -1,11 +1,17 @@
 #include "inc/DBHandler.hpp"
 #include "inc/Run.hpp"
+#include "inc/MultiTreeRun.hpp"
 #include "TMySQLServer.h"
 #include "TMySQLResult.h"
 #include "TMySQLRow.h"
 #include "TPad.h"
 #include "TF1.h"
 #include "inc/Functions.hpp"
+#include "inc/TreeReader.hpp"
+#include "inc/EventCache.hpp"
+#include "inc/CoincCache.hpp"
+#include "inc/EventView.hpp"
+#include "inc/Shard.hpp"
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -26,12 +32,12 @@ int main(int argc, const char** argv) {
 	
 	using namespace std::placeholders;
 	if(argc > 1 && !strcmp(argv[1], "help")) {
-		printf("\nUsage: ./Analyzer 'SQL_QUERY_Runs-and-XValues' coincWindow peSumWindow peSum monChan\n");
+		printf("\nUsage: ./Analyzer 'SQL_QUERY_Runs-and-XValues' coincWindow peSumWindow peSum monChan [--shard i/N]\n");
 		return 1;
 	}
 
-	if(argc != 7) {
-		printf("\nUsage: ./Analyzer 'SQL_QUERY_Runs-and-XValues' coincWindow peSumWindow peSum monChan coincMode\n");
+	if(argc != 7 && !(argc == 9 && !strcmp(argv[7], "--shard"))) {
+		printf("\nUsage: ./Analyzer 'SQL_QUERY_Runs-and-XValues' coincWindow peSumWindow peSum monChan coincMode [--shard i/N]\n");
 		return 1;
 	}
 	
@@ -43,18 +49,54 @@ int main(int argc, const char** argv) {
 	int ch = atoi(argv[5]);
 	int coincMode = atoi(argv[6]);
 	
+	/* --shard i/N does only runs i mod N, so N processes can split the
+	 * campaign. Merge their logs and ROOT files with ShardMerger. */
+	Shard shard;
+	if(argc == 9 && !shard.parse(argv[8])) {
+		return 1;
+	}
+	
 	printf("This was the query sent: %s\n", query.c_str());
+	shard.printHeader();
+	
+	/* get ROOT ready for runs analyzed on several threads at once */
+	Run::initThreadSafety();
+	
+	/* let ROOT unzip baskets on all cores while we read */
+	TreeReader::enableImplicitMT(0);
+	
+	/* set to true to keep decoded events next to each run file so re-analysis
+	 * skips decoding. Each cache is as big as the decoded run and is written
+	 * next to the raw data, so it's off unless asked for. */
+	EventCache::setEnabled(false);
+	
+	/* set to true to keep the coincidences found for each run and setting
+	 * next to the run file too, so re-analysis with the same settings skips
+	 * the search. Like the event cache it writes next to the raw data. */
+	CoincCache::setEnabled(false);
+	
+	/* give a memory budget in bytes to stream each run in chunks instead
+	 * of loading it whole. 0 loads runs into memory as usual. */
+	Run::setMemoryBudget(0);
+	
+	/* pack loaded runs into compact column storage, which takes about half
+	 * the memory of a vector of input_t. */
+	Run::setCompactStorage(true);
+	
+	/* search for coincidences on every core. The results are the same as
+	 * a serial search. */
+	Run::setCoincThreads(0);
 	
 	/* Create a vector to count the hits */
 	// Requires class "Run" -- check this before continuing. There are 5 cpp objects that require "run".
 	std::vector<double> spHits;
 	auto fillSummer = [&spHits](Run* run) {
 		double fillEnd = run->getTagBitEvt(8, 140, 0);
-		std::vector<input_t> spCts = run->getCounts(
-			[fillEnd](input_t x)->input_t{input_t y = x; y.realtime -= fillEnd; return y;},
-			[fillEnd](input_t x)->bool{return x.ch == 5 && x.realtime < fillEnd;}
-		);
-		std::for_each(spCts.begin(), spCts.end(), [&spHits](input_t x){spHits.push_back(x.realtime);});
+		EventView spCts = run->getCountsView(CHMASK(5), -INFINITY, fillEnd).shift(-fillEnd);
+		long i;
+		for(i = 0; i < spCts.size(); i++) {
+			spHits.push_back(spCts.getRealtime(i));
+		}
 	};
 	
 	//------------------------------------------------------------------
@@ -69,32 +111,37 @@ int main(int argc, const char** argv) {
 	/* Fill the background histograms the same way as our vector that created hits */
 	auto bkgSummer = [&singleBkg](Run* run) {
 		double firstDip = run->getTagBitEvt(1<<9, 175, 0);
-		std::vector<input_t> dCts = run->getCounts(
-			[firstDip](input_t x)->input_t{x.realtime -= (firstDip); return x;},
-			[firstDip](input_t x)->bool{return (x.ch==1 || x.ch==2) && x.realtime > (firstDip-500);}
-		);
+		EventView dCts = run->getCountsView(CHMASK(1) | CHMASK(2), nextafter(firstDip-500, INFINITY), INFINITY).shift(-firstDip);
 		if(dCts.empty()) {
 			return;
 		}
-		std::for_each(dCts.begin(), dCts.end(), [&singleBkg](input_t x){singleBkg.Fill(x.realtime);});
+		dCts.fillHist(&singleBkg);
 	};
 	
 	/* Load database from .root file. Choose a path for input file in 
 	 * the Run objects below. */ 
 	if(strstr(query.c_str(), "SELECT")) {
 		DBHandler hand(query.c_str(), coincWindow, peSumWindow, peSum, coincMode);
+		hand.setShard(shard);
 	}
 	else {
 		std::istringstream iss(query);
 		std::string token;
-		while(std::getline(iss, token, ',')) {
+		long position;
+		for(position = 0; std::getline(iss, token, ','); position++) {
 			int runNo = atoi(token.c_str());
+			if(!shard.owns(runNo)) {
+				continue;
+			}
 			printf("opening run %d\n", runNo);
+			shard.printRun(position, runNo);
 			
-			/* Add paths here for output files */
-			Run runMCS1(coincWindow, peSumWindow, peSum, runNo, coincMode, "/media/frank/FreeAgentDrive/UCNtau/2017/processed_output_%05d.root", "tmcs_0");
-			Run runMCS2(coincWindow, peSumWindow, peSum, runNo, coincMode, "/media/frank/FreeAgentDrive/UCNtau/2017/processed_output_%05d.root", "tmcs_1");
-			normNByDip(&runMCS1);
+			/* Add paths here for output files. Both MCS trees are read
+			 * in parallel out of the one file. */
+			MultiTreeRun runFile(coincWindow, peSumWindow, peSum, runNo, coincMode, "/media/frank/FreeAgentDrive/UCNtau/2017/processed_output_%05d.root", {"tmcs_0", "tmcs_1"});
+			Run* runMCS1 = runFile.getRun(0);
+			Run* runMCS2 = runFile.getRun(1);
+			normNByDip(runMCS1);
 			
 		}		
 		return 0;
@@ -271,10 +318,12 @@ int main(int argc, const char** argv) {
 	TH1D scoreB("scoreB", "scoreB", 10000, 0, 10000);
 	auto noiseFinder = [&scoreA, &scoreB](Run* run) {
 		std::vector<input_t> ctsA = run->getCounts(
+			CHMASK(1),
 			[](input_t x)->input_t{return x;},
 			[](input_t x)->bool{return x.ch == 1;}
 		);
 		std::vector<input_t> ctsB = run->getCounts(
+			CHMASK(2),
 			[](input_t x)->input_t{return x;},
 			[](input_t x)->bool{return x.ch == 2;}
 		);
@@ -0,0 +1,258 @@
+#include "inc/Run.hpp"
+#include "inc/TagDemux.hpp"
+#include "inc/DeadtimeVeto.hpp"
+#include <random>
+#include <chrono>
+#include <stdint.h>
+
+#define NANOSECOND .000000001
+#define CLKTONS 0.0000000008
+
+/* Author: Frank M. Gonzalez
+ *
+ * Benchmarks the mcs_events tag bit decoding. It makes up a noisy raw event
+ * stream (mostly PMT hits, with the multiplexed ch3/ch4 tag events and the
+ * ch5/ch9 retriggers sprinkled in), decodes it with TagDemux and with the
+ * backward scan readDataRoot used to do, and prints the cost per event of
+ * each. The two outputs have to be identical, or it exits with 1.
+ *
+ * Usage: ./DemuxBenchmark [numEvents] [noise]
+ * noise is how many PMT hits there are for each tagged event on average
+ * (default 200). The old decoder gets slower the noisier the run. */
+
+static int numBits(uint32_t i) {
+	i = i - ((i >> 1) & 0x55555555);
+	i = (i & 0x33333333) + ((i >> 2) & 0x33333333);
+	return (((i + (i >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+/* The old decoder: the body of readDataRoot's mcs_events loop, scanning back
+ * through the output for each lookback, then the ch9 -> ch19 pass */
+static void oldDecode(const std::vector<input_t>& raw, std::vector<input_t>& data) {
+	long i;
+	int dt;
+	for(i = 0; i < (long)raw.size(); i++) {
+		input_t event = raw[i];
+		if(event.ch == 5 && i > 0) {
+			for(dt = data.size()-1; dt >= 0; dt--) {
+				if(data.at(dt).ch == 5) {
+					break;
+				}
+			}
+			if(dt >= 0 && (event.realtime - data.at(dt).realtime) < 10000*NANOSECOND) {
+				continue;
+			}
+		}
+		if(event.ch == 3) {
+			uint32_t tag = event.tag & (0x7800);
+			int numTags = numBits(tag);
+			for(dt = data.size()-1; dt >= 0; dt--) {
+				if(data.at(dt).ch > 5 || data.at(dt).ch == 3) {
+					break;
+				}
+			}
+			bool close = dt >= 0 && (event.realtime - data.at(dt).realtime) < 1000*NANOSECOND;
+			if(numTags > 2) {
+				if(close) {
+					tag = tag ^ data.at(dt).tag;
+				}
+				else {
+					continue;
+				}
+			}
+			else if(numTags == 0) {
+				if(close) {
+					tag = (1 << (data.at(dt).ch+5));
+				}
+			}
+			else if(numTags == 2) {
+				if(close && numBits(data.at(dt).tag & (0x7800)) == 2) {
+					continue;
+				}
+				else if(close) {
+					tag = tag ^ (1 << (data.at(dt).ch+5));
+				}
+				else {
+					int t = 11;
+					while(!(tag & (1<<t))) {
+						t++;
+					}
+					event.ch = t - 5;
+					data.push_back(event);
+					tag = (tag ^ (1<<t));
+				}
+			}
+			switch(tag) {
+				case (1 << 11) : event.ch = 6; break;
+				case (1 << 12) : event.ch = 7; break;
+				case (1 << 13) : event.ch = 8; break;
+				case (1 << 14) : event.ch = 9; break;
+				default : break;
+			}
+		}
+		if(event.ch == 4) {
+			uint32_t tag = event.tag & (0x600);
+			int numTags = numBits(tag);
+			for(dt = data.size()-1; dt >= 0; dt--) {
+				if(data.at(dt).ch > 9 || data.at(dt).ch == 4) {
+					break;
+				}
+			}
+			bool close = dt >= 0 && (event.realtime - data.at(dt).realtime) < 1000*NANOSECOND;
+			if(numTags > 2) {
+				if(close) {
+					tag = tag ^ data.at(dt).tag;
+				}
+				else {
+					continue;
+				}
+			}
+			else if(numTags == 0) {
+				if(close) {
+					tag = (1 << (data.at(dt).ch-1));
+				}
+			}
+			else if(numTags == 2) {
+				if(close && numBits(data.at(dt).tag & (0x600)) == 2) {
+					continue;
+				}
+				else if(close) {
+					tag = tag ^ (1 << (data.at(dt).ch-1));
+				}
+				else {
+					int t = 9;
+					while(!(tag & (1<<t))) {
+						t++;
+					}
+					event.ch = t + 1;
+					data.push_back(event);
+					tag = (tag ^ (1<<t));
+				}
+			}
+			switch(tag) {
+				case (1 << 9) : event.ch = 10; break;
+				case (1 << 10) : event.ch = 11; break;
+				default : break;
+			}
+		}
+		data.push_back(event);
+	}
+	for(auto it = data.begin(); it < data.end(); it++) {
+		if((*it).ch == 9) {
+			auto backIt = it;
+			for(backIt = it-1; backIt >= data.begin(); backIt--) {
+				if((*backIt).ch == 9) {
+					break;
+				}
+			}
+			if(backIt >= data.begin() && ((*it).realtime - (*backIt).realtime) < 10000*NANOSECOND) {
+				(*backIt).ch = 19;
+			}
+		}
+	}
+}
+
+/* The new decoder, set up the way readDataRoot does it */
+static void newDecode(const std::vector<input_t>& raw, std::vector<input_t>& data) {
+	DeadtimeVeto veto;
+	veto.setDeadtime(5, 10000*NANOSECOND);
+	veto.setDeadtime(9, 10000*NANOSECOND, 19);
+	TagDemux demux(data, veto);
+	demux.push(raw);
+}
+
+/* A made up mcs_events stream. Tagged ch3/ch4 events have one or two tag
+ * bits, and some are followed closely by a bare (no tag bit) half of the
+ * pair, like the real ones. There are noise hits in between. Bare events
+ * always have their pair, so the decoders don't print about them. */
+static std::vector<input_t> makeEvents(long numEvents, double noise) {
+	std::mt19937 gen(12345);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	std::vector<input_t> raw;
+	raw.reserve(numEvents);
+	double realtime = 0.0;
+	while((long)raw.size() < numEvents) {
+		input_t event;
+		event.tag = gen() % 0x200;
+		bool pair = false;
+		if(uniform(gen) < 1.0 / (noise + 1.0)) {
+			int kind = gen() % 4;
+			realtime += 2e-5 * uniform(gen);
+			if(kind < 2) {
+				int base = kind == 0 ? 11 : 9;
+				int numTagBits = kind == 0 ? 4 : 2;
+				int bits = 1 + gen() % 2;
+				int b;
+				for(b = 0; b < bits; b++) {
+					event.tag |= 1 << (base + gen() % numTagBits);
+				}
+				event.ch = kind == 0 ? 3 : 4;
+				pair = gen() % 3 == 0;
+			}
+			else {
+				event.ch = kind == 2 ? 5 : 9;
+			}
+		}
+		else {
+			realtime += 1e-6 * uniform(gen);
+			event.ch = 1 + gen() % 2;
+		}
+		event.realtime = realtime;
+		event.time = (unsigned long)(realtime / CLKTONS);
+		raw.push_back(event);
+
+		/* the bare half of the pair */
+		if(pair) {
+			realtime += 3e-7 * uniform(gen);
+			event.tag = gen() % 0x200;
+			event.realtime = realtime;
+			event.time = (unsigned long)(realtime / CLKTONS);
+			raw.push_back(event);
+		}
+	}
+	return raw;
+}
+
+/* Time one decoder, best of a few tries */
+static double timeDecode(void (*decode)(const std::vector<input_t>&, std::vector<input_t>&), const std::vector<input_t>& raw, std::vector<input_t>& data) {
+	double best = INFINITY;
+	int i;
+	for(i = 0; i < 3; i++) {
+		data.clear();
+		data.reserve(raw.size());
+		auto start = std::chrono::steady_clock::now();
+		decode(raw, data);
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = std::min(best, elapsed);
+	}
+	return best;
+}
+
+int main(int argc, const char** argv) {
+	long numEvents = argc > 1 ? atol(argv[1]) : 2000000;
+	double noise = argc > 2 ? atof(argv[2]) : 200.0;
+	std::vector<input_t> raw = makeEvents(numEvents, noise);
+
+	std::vector<input_t> oldData;
+	std::vector<input_t> newData;
+	double oldTime = timeDecode(oldDecode, raw, oldData);
+	double newTime = timeDecode(newDecode, raw, newData);
+
+	printf("Decoded %ld events (%.0f noise hits per tagged event) into %lu\n", numEvents, noise, newData.size());
+	printf("backward scan: %8.2f ns/event\n", oldTime / numEvents / NANOSECOND);
+	printf("TagDemux:      %8.2f ns/event\n", newTime / numEvents / NANOSECOND);
+
+	/* both have to give exactly the same events */
+	long i;
+	bool same = oldData.size() == newData.size();
+	for(i = 0; same && i < (long)newData.size(); i++) {
+		same = oldData[i].time == newData[i].time && oldData[i].realtime == newData[i].realtime
+			&& oldData[i].ch == newData[i].ch && oldData[i].tag == newData[i].tag;
+	}
+	if(!same) {
+		printf("Outputs DIFFER (%lu vs %lu events, first difference at %ld)!\n", oldData.size(), newData.size(), i - 1);
+		return 1;
+	}
+	printf("Outputs are identical\n");
+	return 0;
+}
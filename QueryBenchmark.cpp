@@ -0,0 +1,114 @@
+#include "inc/Run.hpp"
+#include <random>
+#include <chrono>
+
+#define NANOSECOND .000000001
+
+/* Author: Frank M. Gonzalez
+ *
+ * Benchmarks the Run count and hist queries. It builds a synthetic run in
+ * memory, both as a plain vector of events and packed into an EventStore,
+ * and times getCounts and getHist with std::function arguments against the
+ * templated versions that lambdas go to. It prints the cost per event of
+ * each. The two versions have to give the same results, or it exits with 1.
+ *
+ * Usage: ./QueryBenchmark [numEvents] */
+
+typedef std::function <input_t (input_t)> countExpr;
+typedef std::function <double (input_t)> histExpr;
+typedef std::function <bool (input_t)> selection;
+
+/* A made up run: PMT hits on ch1/ch2 with some monitor counts mixed in */
+static std::vector<input_t> makeEvents(long numEvents) {
+	std::mt19937 gen(4321);
+	std::vector<input_t> events(numEvents);
+	unsigned long ticks = 0;
+	long i;
+	for(i = 0; i < numEvents; i++) {
+		ticks += gen() % 400;
+		events[i].time = ticks;
+		events[i].realtime = ticks * 0.0000000008;
+		int c = gen() % 10;
+		events[i].ch = c < 4 ? 1 : (c < 8 ? 2 : (c == 8 ? 5 : 3));
+		events[i].tag = 0;
+	}
+	return events;
+}
+
+/* Best time per event of a few runs of query */
+template <class Query>
+static double timeQuery(const Query& query, long numEvents) {
+	double best = INFINITY;
+	int i;
+	for(i = 0; i < 5; i++) {
+		auto start = std::chrono::steady_clock::now();
+		query();
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = std::min(best, elapsed);
+	}
+	return best / numEvents / NANOSECOND;
+}
+
+static bool sameCounts(const std::vector<input_t>& a, const std::vector<input_t>& b) {
+	if(a.size() != b.size()) {
+		return false;
+	}
+	size_t i;
+	for(i = 0; i < a.size(); i++) {
+		if(a[i].time != b[i].time || a[i].realtime != b[i].realtime || a[i].ch != b[i].ch || a[i].tag != b[i].tag) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool sameHist(TH1D& a, TH1D& b) {
+	if(a.GetNbinsX() != b.GetNbinsX()) {
+		return false;
+	}
+	int i;
+	for(i = 0; i < a.GetNbinsX() + 2; i++) {
+		if(a.GetBinContent(i) != b.GetBinContent(i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, const char** argv) {
+	long numEvents = argc > 1 ? atol(argv[1]) : 2000000;
+	std::vector<input_t> events = makeEvents(numEvents);
+	bool good = true;
+
+	/* the same query both ways: ch2 events after the first 0.1 s, shifted */
+	auto shift = [](input_t x)->input_t{x.realtime -= 0.1; return x;};
+	auto late2 = [](input_t x)->bool{return x.ch == 2 && x.realtime > 0.1;};
+	auto inMs = [](input_t x)->double{return x.realtime * 1000.0;};
+
+	printf("%ld events, ns/event\n", numEvents);
+	printf("%-8s %-10s %14s %10s\n", "storage", "query", "std::function", "template");
+	int packed;
+	for(packed = 0; packed <= 1; packed++) {
+		Run::setCompactStorage(packed);
+		Run run(50, 500, 2, events, 1);
+		const char* storage = packed ? "packed" : "vector";
+
+		std::vector<input_t> fnCounts;
+		std::vector<input_t> tmplCounts;
+		double fnTime = timeQuery([&]() { fnCounts = run.getCounts(countExpr(shift), selection(late2)); }, numEvents);
+		double tmplTime = timeQuery([&]() { tmplCounts = run.getCounts(shift, late2); }, numEvents);
+		bool same = sameCounts(fnCounts, tmplCounts);
+		printf("%-8s %-10s %14.2f %10.2f %s\n", storage, "getCounts", fnTime, tmplTime, same ? "" : "DIFFERENT!");
+		good = good && same;
+
+		TH1D fnHist;
+		TH1D tmplHist;
+		fnTime = timeQuery([&]() { fnHist = run.getHist(histExpr(inMs), selection(late2)); }, numEvents);
+		tmplTime = timeQuery([&]() { tmplHist = run.getHist(inMs, late2); }, numEvents);
+		same = sameHist(fnHist, tmplHist);
+		printf("%-8s %-10s %14.2f %10.2f %s\n", storage, "getHist", fnTime, tmplTime, same ? "" : "DIFFERENT!");
+		good = good && same;
+	}
+	Run::setCompactStorage(false);
+	return good ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+#include "inc/Shard.hpp"
+#include <string>
+#include <vector>
+#include <string.h>
+
+/* Author: Frank M. Gonzalez
+ *
+ * Merges the outputs of a campaign split with --shard i/N back into what a
+ * single process would have given. With an output ending in .root it adds
+ * up the histograms in the shards' ROOT files. Otherwise it reads the
+ * shards' logs (their printed output) and writes the Data - tables and
+ * measurements in the order of the full run list. */
+
+int main(int argc, const char** argv) {
+	if(argc < 3 || !strcmp(argv[1], "help")) {
+		printf("\nUsage: ./ShardMerger merged.root shard0.root shard1.root ...\n");
+		printf("       ./ShardMerger merged.txt shard0.log shard1.log ...\n");
+		return 1;
+	}
+
+	const char* outName = argv[1];
+	std::vector<std::string> inNames(argv + 2, argv + argc);
+
+	/* histograms */
+	size_t len = strlen(outName);
+	if(len > 5 && !strcmp(outName + len - 5, ".root")) {
+		return Shard::mergeHistograms(inNames, outName) ? 0 : 1;
+	}
+
+	/* tables */
+	FILE* out = fopen(outName, "w");
+	if(out == NULL) {
+		fprintf(stderr, "Error! Can't write %s!\n", outName);
+		return 1;
+	}
+	bool good = Shard::mergeTables(inNames, out);
+	fclose(out);
+	return good ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include "inc/DBHandler.hpp"
+#include "inc/Run.hpp"
+#include "inc/Functions.hpp"
+#include "inc/EventView.hpp"
+#include "TF1.h"
+#include <string.h>
+
+#define NANOSECOND .000000001
+
+/* Author: Frank M. Gonzalez
+ *
+ * Stress test for analyzing runs on several threads. It gets the runs of a
+ * query through DBHandler and analyzes them once one at a time, then again
+ * a few times with DBHandler::setThreads(numThreads). Each pass finds the
+ * coincidences, counts the singles, weights the coincidences with
+ * expWeightMonVect, fits their time spectrum and sums it over the runs with
+ * sumHistograms. Every threaded pass has to give exactly the serial pass's
+ * results, or it prints what differs and exits with 1.
+ *
+ * Usage: ./ThreadStress 'SQL_QUERY_Runs-and-XValues' coincWindow peSumWindow peSum coincMode numThreads [repeats]
+ *
+ * To look for data races, build it with ThreadSanitizer and run it on a few
+ * short runs:
+ *	make clean && make tsan
+ *	TSAN_OPTIONS="halt_on_error=1 second_deadlock_stack=1" ./ThreadStress '...' 50 500 8 1 4 2
+ * ROOT's own libraries aren't built with the sanitizer, so races it reports
+ * entirely inside them (no frame from src/ or this file) are usually false
+ * alarms. Anything with one of our frames in it is real. */
+
+/* the coincidence time spectrum each run is fit and summed with */
+#define STRESSBINS 500
+#define STRESSLOW 0.0
+#define STRESSHIGH 2000.0
+
+/* All the per run results of one pass */
+struct stressPass {
+	std::vector<measurement> coincs;
+	std::vector<measurement> singles;
+	std::vector<measurement> weights;
+	std::vector<measurement> fits;
+	TH1D sum;
+};
+
+static TH1D coincSpectrum(Run* run) {
+	TH1D hist("stressSpectrum", "stressSpectrum", STRESSBINS, STRESSLOW, STRESSHIGH);
+	hist.SetDirectory(0);
+	std::vector<input_t> cts = run->getCoincCounts(
+		[](input_t x)->input_t{return x;},
+		[](input_t x)->bool{return true;}
+	);
+	for(auto it = cts.begin(); it < cts.end(); it++) {
+		hist.Fill((*it).realtime);
+	}
+	return hist;
+}
+
+static stressPass analyze(DBHandler& hand, int numThreads) {
+	stressPass pass;
+	hand.setThreads(numThreads);
+
+	/* number of coincidences, and a checksum of when they were */
+	pass.coincs = hand.getMeasurements([](Run* run)->measurement{
+		std::vector<input_t> cts = run->getCoincCounts(
+			[](input_t x)->input_t{return x;},
+			[](input_t x)->bool{return true;}
+		);
+		measurement result = {(double)cts.size(), 0.0};
+		for(auto it = cts.begin(); it < cts.end(); it++) {
+			result.err += (*it).realtime + (*it).ch;
+		}
+		return result;
+	});
+
+	/* singles in each PMT */
+	pass.singles = hand.getMeasurements([](Run* run)->measurement{
+		measurement result;
+		result.val = run->getNumCounts(CHMASK(1), 0.0, INFINITY);
+		result.err = run->getNumCounts(CHMASK(2), 0.0, INFINITY);
+		return result;
+	});
+
+	pass.weights = hand.getMeasurements([](Run* run)->measurement{
+		return expWeightMonVect(run->getCoincView([](input_t x)->bool{return true;}));
+	});
+
+	/* the fitters have to be safe on several threads at once too */
+	pass.fits = hand.getMeasurements([](Run* run)->measurement{
+		TH1D hist = coincSpectrum(run);
+		measurement result = {0.0, 0.0};
+		if(hist.GetEntries() < 10) {
+			return result;
+		}
+		TF1 fit("stressFit", "expo", STRESSLOW, STRESSHIGH);
+		hist.Fit(&fit, "QN0");
+		result.val = fit.GetParameter(1);
+		result.err = fit.GetParError(1);
+		return result;
+	});
+
+	pass.sum = hand.sumHistograms(coincSpectrum, STRESSBINS, STRESSLOW, STRESSHIGH);
+	return pass;
+}
+
+/* Results have to be bit for bit the same, not just close */
+static int compare(const char* what, const std::vector<measurement>& serial, const std::vector<measurement>& threaded) {
+	if(serial.size() != threaded.size()) {
+		printf("  %s: %lu results serially but %lu on threads!\n", what, serial.size(), threaded.size());
+		return 1;
+	}
+	int bad = 0;
+	size_t i;
+	for(i = 0; i < serial.size(); i++) {
+		if(memcmp(&serial[i], &threaded[i], sizeof(measurement))) {
+			printf("  %s: run %lu gave %.17g +- %.17g serially but %.17g +- %.17g on threads!\n", what, i,
+				serial[i].val, serial[i].err, threaded[i].val, threaded[i].err);
+			bad++;
+		}
+	}
+	return bad;
+}
+
+static int compareHist(TH1D& serial, TH1D& threaded) {
+	int bad = 0;
+	int i;
+	for(i = 0; i < serial.GetNbinsX() + 2; i++) {
+		if(serial.GetBinContent(i) != threaded.GetBinContent(i) || serial.GetBinError(i) != threaded.GetBinError(i)) {
+			printf("  sum: bin %d is %.17g +- %.17g serially but %.17g +- %.17g on threads!\n", i,
+				serial.GetBinContent(i), serial.GetBinError(i), threaded.GetBinContent(i), threaded.GetBinError(i));
+			bad++;
+		}
+	}
+	return bad;
+}
+
+int main(int argc, const char** argv) {
+	if(argc != 7 && argc != 8) {
+		printf("\nUsage: ./ThreadStress 'SQL_QUERY_Runs-and-XValues' coincWindow peSumWindow peSum coincMode numThreads [repeats]\n");
+		return 1;
+	}
+	const char* query = argv[1];
+	int coincWindow = atoi(argv[2]);
+	int peSumWindow = atoi(argv[3]);
+	int peSum = atoi(argv[4]);
+	int coincMode = atoi(argv[5]);
+	int numThreads = atoi(argv[6]);
+	int repeats = argc == 8 ? atoi(argv[7]) : 3;
+
+	Run::initThreadSafety();
+	DBHandler hand(query, coincWindow, peSumWindow, peSum, coincMode);
+
+	stressPass serial = analyze(hand, 1);
+	printf("Serial pass: %lu runs, %.0f coincidences summed\n", serial.coincs.size(), serial.sum.Integral(0, STRESSBINS + 1));
+
+	int bad = 0;
+	int r;
+	for(r = 0; r < repeats; r++) {
+		stressPass threaded = analyze(hand, numThreads);
+		int passBad = compare("coincidences", serial.coincs, threaded.coincs)
+			+ compare("singles", serial.singles, threaded.singles)
+			+ compare("weights", serial.weights, threaded.weights)
+			+ compare("fits", serial.fits, threaded.fits)
+			+ compareHist(serial.sum, threaded.sum);
+		printf("Threaded pass %d (%d threads): %s\n", r + 1, numThreads, passBad ? "DIFFERENT!" : "same as serial");
+		bad += passBad;
+	}
+	return bad ? 1 : 0;
+}
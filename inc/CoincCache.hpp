@@ -0,0 +1,76 @@
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "Run.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class manages the coincidence sidecar cache. For each run file, tree and set of finder
+	parameters we can keep a binary file next to the ROOT file
+	(processed_output_XXXXX.root.<tree>.<coincWindow>_<peSumWindow>_<peSum>_<coincMode>.coc) with
+	everything the finder found: the coincidences, and the photon hits of each one on both PMTs as
+	flat index arrays (see coincHits). The phs are refilled from the number of hits, which is what
+	the finder fills them with.
+
+	Like EventCache, the header stamps the cache format, the decoder version, the size and mtime of
+	the source ROOT file, the run number and the finder parameters, and a cache that disagrees with
+	any of them is ignored and rewritten after the next search. Hits are positions in the run's
+	sorted events, except for streamed runs, which keep copies of their hits. Streamed runs get
+	their own cache file (ending in .scoc) with the copies in it.
+
+	The cache is off by default. Turn it on with setEnabled(true) before building any Runs. Runs
+	look for a cache before searching, so a warm cache skips the search, and for a run that isn't
+	loaded yet, reading the events as well.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+#define COINCCACHEVERSION 2
+
+/* what a cache is for: a run, its source tree and the finder parameters */
+struct coincCacheKey {
+	const char* fileName;
+	const char* treeName;
+	int runNo;
+	int coincWindow;
+	int peSumWindow;
+	int peSum;
+	int coincMode;
+	bool streamed;
+};
+
+/* header at the start of each cache file */
+struct coincCacheHeader {
+	char magic[8];
+	uint32_t formatVersion;
+	uint32_t decoderVersion;
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	int32_t runNo;
+	int32_t coincWindow;
+	int32_t peSumWindow;
+	int32_t peSum;
+	int32_t coincMode;
+	uint32_t eventSize;
+	uint64_t numCoinc;
+	uint64_t numOffsetsA;
+	uint64_t numHitsA;
+	uint64_t numOffsetsB;
+	uint64_t numHitsB;
+	uint64_t numCopied;
+};
+
+class CoincCache
+{
+	private:
+	static bool enabled;
+	static std::string cachePath(const coincCacheKey& key);
+	static bool stampHeader(const coincCacheKey& key, coincCacheHeader& header);
+
+	public:
+	static void setEnabled(bool enable);
+	static bool isEnabled();
+	static bool load(const coincCacheKey& key, coincResults& found);
+	static bool save(const coincCacheKey& key, const coincResults& found);
+};
@@ -0,0 +1,78 @@
+#include <deque>
+#include "Run.hpp"
+#include "EventStore.hpp"
+#include "FastHist.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class finds coincidences in events as they come in, for online monitoring, instead of
+	after a whole run has been loaded into a Run.
+
+	It takes the same parameters as a Run (coincWindow, peSumWindow, peSum, coincMode) and gives
+	the same coincidences findcoincidenceFixed or findcoincidenceMoving would for the same events.
+	Events are handed over one at a time and in time order with push. Only the dagger events
+	(channels 1 and 2) are kept, and only from the oldest undecided start event on. A start event
+	is decided as soon as a later event closes its coincidence window or its peSum tail, so a
+	coincidence comes out no later than the first event after the end of its tail, and the events
+	held never span much more than the two windows. The searches pick up where they left off
+	instead of starting over from the oldest event, so each push costs about the same however
+	many events are held (even in a long moving-window tail).
+
+	push returns how many coincidences it just found, and next hands them out oldest first. The
+	photon sums of each one go into phsA and phsB like the Run's. At the end of the data, flush
+	decides whatever is still open, the same way the finders treat the end of a run.
+
+	Like the finders, windows are compared in whole clock ticks as long as every event's realtime
+	is just its ticks*CLKTONS (as for tmcs_1), and in realtime from the first event that isn't.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class CoincFinder
+{
+	private:
+	int coincWindow;
+	int peSumWindow;
+	int peSum;
+	int coincMode;
+
+	/* the windows in clock ticks, and whether we can still compare ticks */
+	long long coincTicks;
+	long long tailTicks;
+	bool ticks;
+
+	/* dagger events from the oldest undecided start event on */
+	std::deque<input_t> window;
+
+	/* how far into the window the searches for the front start event got:
+	 * the coincidence search (cur), the tail (tailEnd), and the ch1 events
+	 * counted before counted */
+	long cur;
+	long tailEnd;
+	long counted;
+	int ch1Counted;
+
+	/* coincidences found but not yet handed out */
+	std::deque<input_t> found;
+	long numCoinc;
+
+	FastHist phsA;
+	FastHist phsB;
+
+	bool apart(const input_t& earlier, const input_t& later, bool tail);
+	int decide(bool last);
+	void popFront();
+	void restart();
+
+	public:
+	CoincFinder(int coincWindow, int peSumWindow, int peSum, int coincMode);
+	int push(const input_t& event);
+	int flush();
+	bool next(input_t& coinc);
+	void reset();
+	long getNumCoinc();
+	long getWindowSize();
+	TH1D getphsA();
+	TH1D getphsB();
+};
@@ -0,0 +1,80 @@
+#include <vector>
+#include "Run.hpp"
+#include "EventStore.hpp"
+#include "EventScan.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class finds the coincidences of many finder settings (coincWindow, peSumWindow, peSum,
+	coincMode) in one pass over a run, instead of one setCoincWindow/setPeSum/... and a full finder
+	pass per setting.
+
+	Settings are added one at a time with addSetting or as a whole grid with addGrid, which tries
+	every combination of the values given. Each setting always counts its coincidences. keepCoinc
+	has a setting keep the coincidences themselves too, and setScan hands each of its coincidences
+	to an EventScan, so that any summary the scan can make comes out of the same pass. Hand the
+	sweep to Run::sweepCoinc and then read the results with getNumCoinc and getCoinc.
+
+	Only dagger events are searched, so every event counts towards the PE sum. That means a
+	setting's result at a start event depends only on three positions:
+		the first later event on the other dagger channel, where the coincidence is decided,
+		the end of the peSum tail after it,
+		and so the PE sum, which is just the number of events from the start to the end of the tail.
+	The first of these is found once per event for every setting. The tail ends only move forward
+	in time, so they are tracked with one pointer per (coincMode, peSumWindow), shared by every
+	setting that has that pair. Each setting then only keeps its own place in the run (where the
+	deadtime after its last neutron ends). Times are compared with the same clock the finders would
+	use (see EventStore.hpp), so the results are exactly what the regular finder gives for each
+	setting.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+/* one set of finder parameters */
+struct sweepSetting {
+	int coincWindow;
+	int peSumWindow;
+	int peSum;
+	int coincMode;
+};
+
+/* one setting, where it is in the run, and what it has found */
+struct sweepQuery {
+	sweepSetting setting;
+	int tail;
+	long next;
+	long numCoinc;
+	bool keep;
+	std::vector<input_t> coinc;
+	EventScan* scan;
+};
+
+/* a tail end shared by the settings with the same mode and peSumWindow */
+struct sweepTail {
+	int coincMode;
+	int peSumWindow;
+	long end;
+};
+
+class CoincSweep
+{
+	private:
+	std::vector<sweepQuery> queries;
+	std::vector<sweepTail> tails;
+	int findTail(int coincMode, int peSumWindow);
+	template <class Clock, class Events> void searchClock(const Events& evts);
+
+	public:
+	int addSetting(int coincWindow, int peSumWindow, int peSum, int coincMode);
+	int addGrid(const std::vector<int>& coincWindows, const std::vector<int>& peSumWindows, const std::vector<int>& peSums, const std::vector<int>& coincModes);
+	void keepCoinc(int setting);
+	void setScan(int setting, EventScan* scan);
+	template <class Events> void search(const Events& evts);
+	void push(int setting, const input_t& coinc);
+	void reset();
+	int getNumSettings();
+	const sweepSetting& getSetting(int setting);
+	long getNumCoinc(int setting);
+	const std::vector<input_t>& getCoinc(int setting);
+};
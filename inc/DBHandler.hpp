@@ -20,6 +20,9 @@
 #include "TMySQLResult.h"
 #include "TSQLRow.h"
 #include "Run.hpp"
+#include "RunScheduler.hpp"
+#include "RunPrefetcher.hpp"
+#include "Shard.hpp"
 
 /*	------------------------------------------------------------------------------------------------
 	Author: Nathan B. Callahan
@@ -43,7 +46,27 @@
 	
 	The method sumHistograms accepts a function summer as well as histogram binning information.
 	It creates a new histogram with the given size and sums up all the histograms given by applying
-	summer to each of the runs in the list. It returns the summed histogram.
+	summer to each of the runs in the list, bin by bin (under and overflow too) with their errors.
+	The runs' histograms must have the same bins. They are summed pairwise in a fixed tree as the
+	runs finish, so the sum doesn't depend on the order they finish in. It returns the summed
+	histogram, with Sumw2 on.
+	
+	By default the runs are done one at a time, in the order of the query. setThreads(n) does them
+	on n threads instead (0 for one per core) with a RunScheduler, biggest run file first. The
+	results still come back in the order of the query. ROOT is made ready for threads first
+	(Run::initThreadSafety). The analyzer, summer or function given is then called from several
+	threads at once, so it must not touch anything shared without a lock. The runs already keep
+	the cores busy, so with more than one thread each Run searches for coincidences on its own
+	thread (Run::setThreadCoincThreads(1)), whatever Run::setCoincThreads says.
+	
+	When the runs are done one at a time, setPrefetch(depth) has foreach and getMeasurements read
+	up to depth runs ahead on a background thread (see RunPrefetcher), so the disk keeps working
+	while each run is analyzed. The functions given are still only called on this thread.
+	
+	setShard(shard) keeps only the runs of one shard of the campaign (see Shard), so several
+	processes can split the query between them. Each run is tagged with its place in the full
+	list as it starts, and getMeasurements writes out its results, so the shards' outputs can be
+	merged back into what one process would give.
 	------------------------------------------------------------------------------------------------	*/
 
 #pragma once
@@ -60,12 +83,20 @@ class DBHandler
 	char* query;
 	std::vector<int> runs;
 	std::vector<std::string> runBodies;
+	std::vector<long> runPositions;
 	std::vector<double> xs;
 	int coincWindow;
 	int peSumWindow;
 	int peSum;
 	int coincMode;
+	int numThreads;
+	int prefetchDepth;
+	Shard shard;
 	void getRuns();
+	void keepShard();
+	void runEach(const std::function <void (long)>& job);
+	Run* openRun(long k);
+	void forEachRun(const std::function <void (long, Run*)>& func);
 	
 	public:
 	DBHandler(const char* sqlQuery, int coincWindow, int peSumWindow, int peSum, int coincMode);
@@ -74,6 +105,9 @@ class DBHandler
 	std::vector<double> getXs();
 	TH1D sumHistograms(const std::function <TH1D (Run*)>& summer, int nbins, double low, double high);
 	void foreach(const std::function <void (Run*)>& func);
+	void setThreads(int numThreads);
+	void setPrefetch(int depth);
+	void setShard(const Shard& shard);
 	
 };
 
@@ -0,0 +1,76 @@
+#include <vector>
+#include "Run.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class applies the software deadtimes we use to correct for multiple pulsing.
+
+	Each channel can be given a deadtime (in seconds) with setDeadtime. An event that comes less
+	than the deadtime after the last accepted event on its channel is a retrigger, and is either
+	dropped (the default) or accepted after relabelling that earlier event to another channel
+	(e.g. ch9 retriggers are kept as ch19). Channels without a deadtime are always accepted.
+
+	The method push checks one event, in time order, and appends it to the output if it is
+	accepted. Only the last accepted time and output index per channel are kept, so each event
+	costs the same no matter how long ago the last one on its channel was.
+
+	The number of events dropped or relabelled on each channel is counted, and printCounts
+	reports them after a decode.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+/* relabel channel for rules that drop retriggers */
+#define VETODROP -1
+
+/* deadtime rule and running state for a single channel */
+struct vetoChannel {
+	double deadtime;
+	int relabel;
+	bool active;
+	double lastTime;
+	long lastIndex;
+	long numDropped;
+	long numRelabelled;
+};
+
+class DeadtimeVeto
+{
+	private:
+	std::vector<vetoChannel> channels;
+
+	public:
+	DeadtimeVeto();
+	void setDeadtime(int ch, double deadtime, int relabel = VETODROP);
+	bool push(const input_t& event, std::vector<input_t>& out);
+	long getNumDropped(int ch);
+	long getNumRelabelled(int ch);
+	void printCounts();
+};
+
+/* Check an event against its channel's deadtime and append it to out if
+ * accepted. Returns false if the event was dropped. It's called for every
+ * event of a decode, so it lives here where it can be inlined. */
+inline bool DeadtimeVeto::push(const input_t& event, std::vector<input_t>& out) {
+	if(event.ch < 0 || event.ch >= (int)channels.size() || !channels[event.ch].active) {
+		out.push_back(event);
+		return true;
+	}
+	vetoChannel& chan = channels[event.ch];
+
+	/* if the time since the last accepted event on this channel is
+	 * < DEADTIME, it's a retrigger */
+	if(chan.lastIndex >= 0 && (event.realtime - chan.lastTime) < chan.deadtime) {
+		if(chan.relabel == VETODROP) {
+			chan.numDropped++;
+			return false;
+		}
+		out[chan.lastIndex].ch = chan.relabel;
+		chan.numRelabelled++;
+	}
+	out.push_back(event);
+	chan.lastTime = event.realtime;
+	chan.lastIndex = out.size() - 1;
+	return true;
+}
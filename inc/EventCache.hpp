@@ -0,0 +1,53 @@
+#include <vector>
+#include <stdint.h>
+#include "Run.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class manages the decoded-event sidecar cache. For each run file and tree we can keep
+	a binary file next to the ROOT file (processed_output_XXXXX.root.<tree>.evc) that holds the
+	final, sorted vector of input_t that readDataRoot produces.
+
+	The cache file is a fixed header followed by the raw input_t array. The header stamps the
+	cache format, the decoder version (DECODERVERSION in Run.hpp), and the size and mtime of the
+	source ROOT file. If any of these disagree with what we have now, the cache is ignored and
+	gets rewritten after the next full decode.
+
+	The cache is off by default. Turn it on with setEnabled(true) before building any Runs.
+
+	The method load mmaps a valid cache and fills the given vector from the mapping, so a warm
+	cache costs a page-cache read instead of ROOT decompression and re-decoding.
+
+	The method save writes the vector to a temporary file and renames it into place, so a
+	half-written cache is never picked up by another process.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+#define EVENTCACHEVERSION 1
+
+/* header at the start of each cache file */
+struct eventCacheHeader {
+	char magic[8];
+	uint32_t formatVersion;
+	uint32_t decoderVersion;
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	uint64_t numEvents;
+	uint64_t eventSize;
+};
+
+class EventCache
+{
+	private:
+	static bool enabled;
+	static std::string cachePath(const char* fileName, const char* treeName);
+	static bool sourceStamp(const char* fileName, uint64_t* size, int64_t* mtime);
+
+	public:
+	static void setEnabled(bool enable);
+	static bool isEnabled();
+	static bool load(const char* fileName, const char* treeName, std::vector<input_t>& events);
+	static bool save(const char* fileName, const char* treeName, const std::vector<input_t>& events);
+};
@@ -0,0 +1,61 @@
+#include <vector>
+#include <functional>
+#include "Run.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class batches several count queries so they can all be answered in one pass over a run,
+	instead of one full scan per getCounts or getCoincCounts call.
+
+	Each query is a selection plus a sink for the events it selects:
+		addVector - keeps the selected events, transformed (like getCounts)
+		addCounter - just counts them
+		addSum - adds up a value of each of them
+		addHist - fills a histogram the caller owns with a value of each of them
+	The add functions return the query's number, which is used to pick up its result afterwards
+	with getEvents, getCount or getSum.
+
+	Once the queries are set, hand the scan to Run::scanCounts (every event) or Run::scanCoincCounts
+	(the coincidences) and every query sees every event, in time order, in a single sweep. The
+	method push feeds one event by hand, and reset clears the results to run the scan again.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+/* kinds of sink */
+#define SCANVECTOR 0
+#define SCANCOUNT 1
+#define SCANSUM 2
+#define SCANHIST 3
+
+/* one query and its result */
+struct scanQuery {
+	int sink;
+	std::function <bool (input_t)> selection;
+	std::function <input_t (input_t)> transform;
+	std::function <double (input_t)> value;
+	std::vector<input_t> events;
+	long count;
+	double sum;
+	TH1D* hist;
+};
+
+class EventScan
+{
+	private:
+	std::vector<scanQuery> queries;
+	int addQuery(int sink, const std::function <bool (input_t)>& selection);
+
+	public:
+	int addVector(const std::function <bool (input_t)>& selection, const std::function <input_t (input_t)>& transform);
+	int addCounter(const std::function <bool (input_t)>& selection);
+	int addSum(const std::function <bool (input_t)>& selection, const std::function <double (input_t)>& value);
+	int addHist(const std::function <bool (input_t)>& selection, const std::function <double (input_t)>& value, TH1D* hist);
+	void push(const input_t& event);
+	void reset();
+	int getNumQueries();
+	const std::vector<input_t>& getEvents(int query);
+	long getCount(int query);
+	double getSum(int query);
+};
@@ -0,0 +1,137 @@
+#include <vector>
+#include <stdint.h>
+#include "Run.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class holds a run's events as separate arrays (structure of arrays) instead of a vector
+	of input_t. It is what Run uses in compact storage mode (see Run::setCompactStorage).
+
+	Each event is kept as its 64 bit clock ticks, an 8 bit channel and a 16 bit tag, or 11 bytes
+	instead of the 24 of an input_t. The realtime is rebuilt from the ticks (ticks*CLKTONS) when
+	asked for, exactly as readDataRoot computes it. Trees that store their own realtime may not
+	match that, so if any event disagrees the realtimes are kept in a column of their own.
+
+	The method pack fills the store from a vector of input_t. It returns false (and leaves the
+	store empty) if a channel or tag doesn't fit, in which case the caller keeps the vector.
+
+	Scans that only look at channels or times walk just those columns, while get and unpack build
+	input_t's for everything that still wants them.
+
+	The eventCh, eventTime, eventRealtime, eventTag and eventAt functions below read an event out
+	of either a vector of input_t or an EventStore, so the same code can be written for both. An
+	EventSubset is a list of indices into either one (e.g. just the dagger channels) that reads the
+	same way.
+
+	The coincidence finders compare event times through a clock. tickClock compares the integer
+	clock ticks, with each window rounded down to the whole ticks that fit in it, so comparisons
+	are exact and don't depend on how the realtimes were rounded. It is only right when every
+	realtime is ticks*CLKTONS (realtimeFromTicks). realtimeClock compares the realtimes, for trees
+	that store their own.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+#ifndef CLKTONS
+#define CLKTONS 0.0000000008
+#endif
+
+class EventStore
+{
+	private:
+	std::vector<uint64_t> ticks;
+	std::vector<uint8_t> chs;
+	std::vector<uint16_t> tags;
+
+	/* only filled if realtime isn't just ticks*CLKTONS */
+	std::vector<double> realtimes;
+	bool explicitRealtime;
+
+	public:
+	EventStore();
+	bool pack(const std::vector<input_t>& events);
+	void unpack(std::vector<input_t>& out) const;
+	void clear();
+	size_t memoryUsage() const;
+
+	size_t size() const { return ticks.size(); }
+	bool empty() const { return ticks.empty(); }
+	unsigned long getTime(long i) const { return ticks[i]; }
+	int getCh(long i) const { return chs[i]; }
+	int getTag(long i) const { return tags[i]; }
+	double getRealtime(long i) const {
+		return explicitRealtime ? realtimes[i] : ((double)ticks[i]) * CLKTONS;
+	}
+	input_t get(long i) const {
+		input_t event;
+		event.time = ticks[i];
+		event.realtime = this->getRealtime(i);
+		event.ch = chs[i];
+		event.tag = tags[i];
+		return event;
+	}
+};
+
+/* read events out of either storage */
+inline int eventCh(const std::vector<input_t>& evts, long i) { return evts[i].ch; }
+inline int eventCh(const EventStore& evts, long i) { return evts.getCh(i); }
+inline unsigned long eventTime(const std::vector<input_t>& evts, long i) { return evts[i].time; }
+inline unsigned long eventTime(const EventStore& evts, long i) { return evts.getTime(i); }
+inline int eventTag(const std::vector<input_t>& evts, long i) { return evts[i].tag; }
+inline int eventTag(const EventStore& evts, long i) { return evts.getTag(i); }
+inline double eventRealtime(const std::vector<input_t>& evts, long i) { return evts[i].realtime; }
+inline double eventRealtime(const EventStore& evts, long i) { return evts.getRealtime(i); }
+inline const input_t& eventAt(const std::vector<input_t>& evts, long i) { return evts[i]; }
+inline input_t eventAt(const EventStore& evts, long i) { return evts.get(i); }
+
+/* the events at a sorted list of indices into evts */
+template <class Events>
+struct EventSubset {
+	const Events& evts;
+	const std::vector<uint32_t>& index;
+	EventSubset(const Events& evts, const std::vector<uint32_t>& index) : evts(evts), index(index) {}
+	size_t size() const { return index.size(); }
+};
+template <class Events>
+inline int eventCh(const EventSubset<Events>& sub, long i) { return eventCh(sub.evts, sub.index[i]); }
+template <class Events>
+inline unsigned long eventTime(const EventSubset<Events>& sub, long i) { return eventTime(sub.evts, sub.index[i]); }
+template <class Events>
+inline int eventTag(const EventSubset<Events>& sub, long i) { return eventTag(sub.evts, sub.index[i]); }
+template <class Events>
+inline double eventRealtime(const EventSubset<Events>& sub, long i) { return eventRealtime(sub.evts, sub.index[i]); }
+template <class Events>
+inline input_t eventAt(const EventSubset<Events>& sub, long i) { return eventAt(sub.evts, sub.index[i]); }
+
+/* times as integer clock ticks. A window of some seconds is the number of
+ * whole ticks in it. The small offset keeps a window that is a whole number
+ * of ticks (100 ns is 125) from being rounded down by the division. */
+struct tickClock {
+	typedef long long span;
+	static span window(double seconds) { return (span)floor(seconds/CLKTONS + 0.000001); }
+	template <class Events>
+	static span at(const Events& evts, long i) { return (span)eventTime(evts, i); }
+};
+
+/* times as realtimes, in seconds */
+struct realtimeClock {
+	typedef double span;
+	static span window(double seconds) { return seconds; }
+	template <class Events>
+	static span at(const Events& evts, long i) { return eventRealtime(evts, i); }
+};
+
+/* Check whether every realtime in evts is just its ticks*CLKTONS, so the
+ * events can be compared with tickClock */
+template <class Events>
+bool realtimeFromTicks(const Events& evts) {
+	long size = evts.size();
+	long i;
+	for(i = 0; i < size; i++) {
+		if(eventRealtime(evts, i) != ((double)eventTime(evts, i)) * CLKTONS) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,66 @@
+#include <vector>
+#include <stdio.h>
+#include "Run.hpp"
+#include "TreeReader.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class walks a tree's events in time order without ever holding the whole run in memory.
+	It is what Run uses in streaming mode (see Run::setMemoryBudget).
+
+	The constructor takes the tree, whether realtime should be rebuilt from the clock ticks (as
+	readDataRoot does for tmcs_1), and a memory budget in bytes.
+
+	The first call to next does an external merge sort: the tree is read through TreeReader into
+	a buffer of half the budget, which is sorted by realtime and, if the tree doesn't fit, spilled
+	to a temporary file as a sorted run. If the whole tree fits in one buffer it stays in memory
+	and nothing is written. The sorted runs are then merged with a small read buffer each.
+
+	The method next fills chunk with the next (at most budget/4 bytes worth of) events in time
+	order and returns false once the stream is exhausted.
+
+	The method rewind starts the stream over from the beginning without re-reading the tree.
+
+	The method realtimeFromTicks says whether every realtime in the stream is just its ticks*CLKTONS
+	(always so when they are rebuilt), so the coincidence finders can compare clock ticks. It is
+	found while sorting, which it starts if next hasn't yet.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class EventStream
+{
+	private:
+	TreeReader reader;
+	bool recomputeRealtime;
+	bool tickRealtime;
+	bool sorted;
+	size_t runEvents;
+	size_t chunkEvents;
+
+	/* the sorted runs. If there is only one it lives in memory. */
+	std::vector<input_t> memRun;
+	size_t memPos;
+	std::vector<FILE*> runFiles;
+	std::vector<long> runLengths;
+
+	/* merge state, one read buffer per run */
+	std::vector<std::vector<input_t> > runBufs;
+	std::vector<size_t> runPos;
+	std::vector<long> runLeft;
+	std::vector<std::pair<double, int> > heap;
+
+	void sortRuns();
+	void spillRun(std::vector<input_t>& buffer);
+	void fixRealtime(std::vector<input_t>& buffer);
+	bool refill(int run);
+
+	public:
+	EventStream(TTree* tree, bool recomputeRealtime, size_t budgetBytes);
+	~EventStream();
+	bool isValid();
+	bool next(std::vector<input_t>& chunk);
+	void rewind();
+	bool realtimeFromTicks();
+};
@@ -0,0 +1,99 @@
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <stdint.h>
+#include "Run.hpp"
+#include "EventStore.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class is a read-only view of some of a run's events, returned by Run::getCountsView and
+	Run::getCoincView in place of a copied vector of input_t.
+
+	A view is a list of positions into the run's own events (the vector or the packed EventStore),
+	so selecting events costs at most four bytes each and nothing is copied. A time-range view on
+	a channel mask is just a slice of the run's channel index and costs nothing at all.
+
+	Transforms are lazy. shift returns a view with the realtimes moved by an offset, applied as
+	each event is read, so e.g. times relative to the end of the fill never exist as a copy.
+
+	Events are read with operator[] or getRealtime/getCh/getTime, or by iterating from begin to
+	end. fillHist and toVector are there for when a histogram or a real vector is wanted.
+
+	A view borrows from the Run it came from, so it must not outlive it. In streaming mode there
+	is nothing to borrow, so the view holds its own copy of the selected events instead.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class EventView
+{
+	private:
+	const std::vector<input_t>* events;
+	const EventStore* store;
+	const uint32_t* index;
+	long num;
+	double offset;
+
+	/* views we built the index (or events) for keep them alive here */
+	std::shared_ptr<const std::vector<uint32_t> > ownedIndex;
+	std::shared_ptr<const std::vector<input_t> > ownedEvents;
+
+	/* position in the run of the ith event. Without an index the view
+	 * is all of events. */
+	long position(long i) const { return index != NULL ? (long)index[i] : i; }
+
+	public:
+	class iterator {
+		const EventView* view;
+		long i;
+		public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef input_t value_type;
+		typedef long difference_type;
+		typedef const input_t* pointer;
+		typedef input_t reference;
+		iterator(const EventView* view, long i) : view(view), i(i) {}
+		input_t operator*() const { return (*view)[i]; }
+		iterator& operator++() { i++; return *this; }
+		iterator operator++(int) { iterator old = *this; i++; return old; }
+		iterator& operator--() { i--; return *this; }
+		iterator operator+(long n) const { return iterator(view, i + n); }
+		iterator operator-(long n) const { return iterator(view, i - n); }
+		long operator-(const iterator& rhs) const { return i - rhs.i; }
+		bool operator==(const iterator& rhs) const { return i == rhs.i; }
+		bool operator!=(const iterator& rhs) const { return i != rhs.i; }
+		bool operator<(const iterator& rhs) const { return i < rhs.i; }
+	};
+
+	EventView();
+	EventView(const std::vector<input_t>& events, const uint32_t* index, long num);
+	EventView(const EventStore& store, const uint32_t* index, long num);
+	EventView(const std::vector<input_t>& events, std::shared_ptr<const std::vector<uint32_t> > index);
+	EventView(const EventStore& store, std::shared_ptr<const std::vector<uint32_t> > index);
+	EventView(std::shared_ptr<const std::vector<input_t> > events);
+
+	EventView shift(double dt) const;
+	void fillHist(TH1D* hist) const;
+	std::vector<input_t> toVector() const;
+
+	long size() const { return num; }
+	bool empty() const { return num == 0; }
+	iterator begin() const { return iterator(this, 0); }
+	iterator end() const { return iterator(this, num); }
+	double getRealtime(long i) const {
+		return (store != NULL ? store->getRealtime(this->position(i)) : (*events)[this->position(i)].realtime) + offset;
+	}
+	int getCh(long i) const {
+		return store != NULL ? store->getCh(this->position(i)) : (*events)[this->position(i)].ch;
+	}
+	unsigned long getTime(long i) const {
+		return store != NULL ? store->getTime(this->position(i)) : (*events)[this->position(i)].time;
+	}
+	input_t operator[](long i) const {
+		input_t event = store != NULL ? store->get(this->position(i)) : (*events)[this->position(i)];
+		event.realtime += offset;
+		return event;
+	}
+};
@@ -0,0 +1,75 @@
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <math.h>
+#include "TH1D.h"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class is a plain fixed-bin histogram for filling in the analysis loops. It is turned into
+	a TH1D (toTH1D) only when one is needed for saving or fitting.
+
+	The bins are a single contiguous array, with underflow in bin 0 and overflow in bin numBins+1
+	like a TH1D, and they are only allocated on the first fill. Filling picks the bin with the same
+	arithmetic as TAxis::FindBin, so a FastHist converts to exactly the TH1D that filling one
+	directly would have given, statistics included. Out of range values are clamped into the
+	underflow and overflow bins with conditional moves rather than branches. Unlike a TH1D there is
+	no automatic range: the range has to have high > low, or nothing is filled.
+
+	Thread-local copies of a FastHist can be filled separately and then combined with add, as long
+	as they have the same binning.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class FastHist
+{
+	private:
+	std::string name;
+	std::string title;
+	int numBins;
+	double low;
+	double high;
+
+	/* bin contents, including under/overflow. Empty until the first fill. */
+	std::vector<double> bins;
+
+	/* what TH1 keeps for its statistics (in range fills only) */
+	double entries;
+	double sumw;
+	double sumw2;
+	double sumwx;
+	double sumwx2;
+
+	public:
+	FastHist();
+	FastHist(const char* name, const char* title, int numBins, double low, double high);
+	void add(const FastHist& other);
+	void reset();
+	TH1D toTH1D() const;
+	double getEntries() const { return entries; }
+	double getBinContent(int bin) const { return bins.empty() ? 0.0 : bins[bin]; }
+
+	void fill(double x) {
+		if(bins.empty()) {
+			/* a histogram without a range never gets its bins */
+			if(!(high > low)) {
+				return;
+			}
+			bins.assign(numBins + 2, 0.0);
+		}
+		double pos = numBins * (x - low) / (high - low);
+		pos = x < low ? -1.0 : pos;
+		pos = !(x < high) ? numBins : pos;
+		int bin = 1 + (int)pos;
+		bins[bin] += 1.0;
+		entries += 1.0;
+		if(bin > 0 && bin <= numBins) {
+			sumw += 1.0;
+			sumw2 += 1.0;
+			sumwx += x;
+			sumwx2 += x * x;
+		}
+	}
+};
@@ -1,4 +1,6 @@
 #include "Run.hpp"
+#include "EventScan.hpp"
+#include "EventView.hpp"
 #include "TMySQLServer.h"
 #include "TMySQLResult.h"
 #include "TMySQLRow.h"
@@ -49,10 +51,12 @@ std::vector<double> hMinGxHits(Run* run);
 
 double getDeadTimeCounts(Run* run, double start, double end);
 
+double getDeadTimeCounts(Run* run, double start, double end, const std::vector<input_t>& cts);
+
 void bkgRunBkg(Run* run);
 
 void normNByDip(Run* run);
 
 void normNByDipSing(Run* run);
 
-measurement expWeightMonVect(std::vector<input_t> &cts);
\ No newline at end of file
+measurement expWeightMonVect(const EventView &cts);
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include <vector>
+#include <string>
+#include "TFile.h"
+#include "Run.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class loads several MCS trees (usually tmcs_0 and tmcs_1) out of one run file at once.
+
+	The constructor takes the same parameters as the namecycle Run constructor, but with a list
+	of tree names. It starts one thread per tree. Each thread reads its tree a cluster at a time
+	through TreeReader and sorts it, just like readDataRoot(namecycle). ROOT won't let two threads
+	into one TFile at the same time, so the first tree is read through our file and every other
+	tree thread opens its own copy of the file for the read (and has its own basket cache). The
+	reads, the basket unzipping, the sorting and the EventCache lookups all run in parallel. The
+	extra copies are closed once their tree is read.
+
+	Each tree then gets a regular Run that shares our TFile, so getRun(i) can be handed to any of
+	the analysis functions. The Runs and the file are cleaned up with this object.
+
+	Trees are always loaded whole here, even if a streaming memory budget is set.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class MultiTreeRun
+{
+	private:
+	char fileName[256];
+	TFile* dataFile;
+	std::vector<std::string> treeNames;
+	std::vector<Run*> runs;
+
+	public:
+	MultiTreeRun(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode, std::string runBody, std::vector<std::string> trees);
+	~MultiTreeRun();
+	bool exists();
+	int getNumRuns();
+	Run* getRun(int i);
+	Run* getRun(const char* tree);
+};
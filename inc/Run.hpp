@@ -5,6 +5,9 @@
 #include <fstream>
 #include <iterator>
 #include <functional>
+#include <chrono>
+#include <map>
+#include <stdint.h>
 #include "stdio.h"
 #include "TH1D.h"
 #include "TFile.h"
@@ -14,12 +17,17 @@
 #include "TFitResult.h"
 #include "TFitResultPtr.h"
 #include "TMath.h"
+#include "FastHist.hpp"
 
 /* "#pragma once" tells the compiler to only compile included files once
  * to prevent multiple locations for Run.hpp appearing */
  
 #pragma once
 
+/* Version of the event decoding in readDataRoot. Bump this whenever the 
+ * decoded output changes so cached events get thrown out. */
+#define DECODERVERSION 1
+
 /* Create a structure that contains the input from our runs: 
  * the tvc*/
 struct input_t {
@@ -29,6 +37,51 @@ struct input_t {
 	int tag;
 };
 
+/* Channel masks pick out channels by bit, e.g. CHMASK(1) | CHMASK(2) is 
+ * both daggers. Only channels 0-31 can be masked. */
+#define CHMASK(ch) (1u << (ch))
+inline bool inChannelMask(int ch, uint32_t chMask) {
+	return ch >= 0 && ch < 32 && ((chMask >> ch) & 1u);
+}
+
+class EventStream;
+class EventStore;
+class EventScan;
+class EventView;
+class CoincSweep;
+
+/* The realtimes of the stable rising and falling edges of one tag bit 
+ * mask, in time order (see getTagBitEvt) */
+struct tagEdges {
+	std::vector<double> rising;
+	std::vector<double> falling;
+	bool ordered;
+};
+
+/* The photon hits of every coincidence on one PMT, flattened: the hits of
+ * coincidence k are positions index[offsets[k]] up to index[offsets[k+1]]
+ * in the run's events (see Run::getPhotonTrace) */
+struct coincHits {
+	std::vector<uint32_t> index;
+	std::vector<uint32_t> offsets;
+	void clear() { index.clear(); offsets.clear(); }
+	long size() const { return offsets.empty() ? 0 : (long)offsets.size() - 1; }
+	bool empty() const { return this->size() == 0; }
+	long numHits(long k) const { return offsets[k+1] - offsets[k]; }
+	const uint32_t* hits(long k) const { return index.data() + offsets[k]; }
+};
+
+/* What a coincidence search found over some stretch of the run, kept apart
+ * from the Run's own so stretches can be searched in parallel and merged */
+struct coincResults {
+	std::vector<input_t> coinc;
+	coincHits pmtAHits;
+	coincHits pmtBHits;
+	std::vector<input_t> copiedHits;
+	FastHist phsA;
+	FastHist phsB;
+};
+
 /* Create a Measurement Struct, which contains the values and errors 
  * of our varous run inputs. */
 struct measurement {
@@ -62,6 +115,33 @@ class Run
 
 	char* fileName;
 	TFile* dataFile;
+	bool ownsFile;
+	
+	/* streaming mode: walk the run in chunks instead of loading data */
+	static size_t defaultMemoryBudget;
+	size_t memoryBudget;
+	std::string streamTree;
+	
+	/* the tree our events come from, to find our coincidence cache */
+	std::string sourceTree;
+	EventStream* stream;
+	
+	/* compact storage: data is packed into store after loading */
+	static bool compactStorage;
+	EventStore* store;
+	
+	/* threads for the coincidence search of a loaded run, and an override
+	 * for Runs searched on this thread (0 for none) */
+	static int coincThreads;
+	static thread_local int threadCoincThreads;
+	
+	/* per-channel lists of event indices, built on first use, and merged
+	 * lists for the multi-channel masks we've been asked for */
+	std::vector<std::vector<uint32_t> > chIndex;
+	std::map<uint32_t, std::vector<uint32_t> > maskIndex;
+	
+	/* stable tag bit edges, found once per mask we're asked about */
+	std::map<int, tagEdges> edgeIndex;
 	
 
 	double clUp;
@@ -69,25 +149,57 @@ class Run
 	std::vector<input_t> data;    //A vector holding all events in the file for Long run
 	std::vector<input_t> coinc;
 	
-	std::vector<std::vector<input_t> > pmtACoincHits;
-	std::vector<std::vector<input_t> > pmtBCoincHits;
+	coincHits pmtACoincHits;
+	coincHits pmtBCoincHits;
+	
+	/* in streaming mode there are no run events to point at, so the hits
+	 * are copied here and the coincHits point into this instead */
+	std::vector<input_t> copiedHits;
 
 	TTree* dataTree;
 	TTree* coincTree;
 	
-	TH1D pmt1SummedWaveform;
-	TH1D pmt2SummedWaveform;
+	FastHist pmt1SummedWaveform;
+	FastHist pmt2SummedWaveform;
 	
-	TH1D phsA;
-	TH1D phsB;
+	FastHist phsA;
+	FastHist phsB;
 	
 
 	void readDataRoot();
 	void readDataRoot(const char* namecycle);
+	void printReadRate(const char* treeName, long numRead, std::chrono::steady_clock::time_point startTime);
 	void findcoincidenceFixed();
 	void findcoincidenceMoving();
+	template <class Clock, class Events> long findcoincidenceFixed(const Events& evts, long first, long end, bool last, coincResults& found);
+	template <class Clock, class Events> long findcoincidenceMoving(const Events& evts, long first, long end, bool last, coincResults& found);
+	template <class Events> void findcoincidenceDaggers(const Events& evts, bool moving);
+	template <class Clock, class Events> void findcoincidenceChunks(const Events& evts, bool moving);
+	coincResults newCoincResults();
+	void mergeCoinc(const coincResults& found);
+	bool loadCoincCache();
+	void saveCoincCache();
+	template <class Events> double findTagBitEvt(const Events& evts, int mask, double offset, bool edge);
+	template <class Events> void findTagEdges(const Events& evts, int mask, tagEdges& edges);
+	bool loadData();
+	void packData();
+	void buildChannelIndex();
+	const std::vector<uint32_t>& getChannelIndex(uint32_t chMask);
+	void findTimeRange(const std::vector<uint32_t>& index, double t0, double t1, long& first, long& last);
+	long getEventBlock(long first, std::vector<input_t>& scratch, const input_t*& block);
+	void loadCoinc();
+	void clearCoinc();
+	EventView getHitsView(const coincHits& hits, long k);
+	void copyPhotonTrace(int pmt, long k, std::vector<input_t>& trace);
+	static TH1D fillUnitHist(const std::vector<double>& points, int emptyBins);
+	bool openStream();
+	void findcoincidenceStream(coincResults& found);
+	template <class Clock> void findcoincidenceStream(coincResults& found);
+	std::vector<input_t> getCountsStream(const std::function <input_t (input_t)>& expr, const std::function <bool (input_t)>& selection);
+	TH1D getHistStream(const std::function <double (input_t)>& expr, const std::function <bool (input_t)>& selection);
+	void scanCountsStream(EventScan& scan);
+	double getTagBitEvtStream(int mask, double offset, bool edge);
 	void integrateGV();
-	int numBits(uint32_t i);
 	
 	public:
 	std::vector<double> allpmtAHits;
@@ -102,11 +214,18 @@ class Run
 	int getPeSum();
 	int getCoincMode();
 	bool exists();
+	bool preload();
+	static void setMemoryBudget(size_t bytes);
+	static void setCompactStorage(bool compact);
+	static void setCoincThreads(int threads);
+	static int setThreadCoincThreads(int threads);
+	static void initThreadSafety();
 	
 	Run(int coincWindow, int peSumWindow, int peSum, const char* fName, int coincMode);
 	Run(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode, std::string runBody);
 	Run(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode, std::string runBody, const char* namecycle);
 	Run(int coincWindow, int peSumWindow, int peSum, std::vector<input_t> cts, int coincMode);
+	Run(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode, TFile* sharedFile, const char* treeName, std::vector<input_t>& events);
 	~Run();
 
 
@@ -114,7 +233,29 @@ class Run
 	TH1D getHist(const std::function <double (input_t)>& expr, const std::function <bool (input_t)>& selection);
 	std::vector<input_t> getCoincCounts(const std::function <input_t (input_t)>& expr, const std::function <bool (input_t)>& selection);
 	std::vector<input_t> getCounts(const std::function <input_t (input_t)>& expr, const std::function <bool (input_t)>& selection);
+	TH1D getHist(uint32_t chMask, const std::function <double (input_t)>& expr, const std::function <bool (input_t)>& selection);
+	std::vector<input_t> getCounts(uint32_t chMask, const std::function <input_t (input_t)>& expr, const std::function <bool (input_t)>& selection);
+	std::vector<input_t> getCounts(uint32_t chMask, double t0, double t1, const std::function <input_t (input_t)>& expr);
+	long getNumCounts(uint32_t chMask, double t0, double t1);
+	void scanCounts(EventScan& scan);
+	void scanCoincCounts(EventScan& scan);
+	void sweepCoinc(CoincSweep& sweep);
+	EventView getCountsView(uint32_t chMask, double t0, double t1);
+	EventView getCountsView(const std::function <bool (input_t)>& selection);
+	EventView getCoincView(const std::function <bool (input_t)>& selection);
 	std::vector<double> getPhotonTracesVect(int pmt, const std::function <double (std::vector<input_t>)>& expr,const std::function <bool (std::vector<input_t>)>& selection);
+	long getNumPhotonTraces();
+	EventView getPhotonTrace(int pmt, long k);
+	
+	/* Same as the std::function versions above, but take any callable so
+	 * the selection and transform inline into the loop over the events.
+	 * Lambdas passed straight in pick these up automatically. */
+	template <class Expr, class Sel> TH1D getCoincHist(const Expr& expr, const Sel& selection);
+	template <class Expr, class Sel> TH1D getHist(const Expr& expr, const Sel& selection);
+	template <class Expr, class Sel> std::vector<input_t> getCoincCounts(const Expr& expr, const Sel& selection);
+	template <class Expr, class Sel> std::vector<input_t> getCounts(const Expr& expr, const Sel& selection);
+	template <class Expr, class Sel> std::vector<double> getPhotonTracesVect(int pmt, const Expr& expr, const Sel& selection);
+	
 	TH1D getHistIterator(
 		const std::function <double (std::vector<input_t>::iterator, std::vector<input_t>::iterator, std::vector<input_t>::iterator)>& expr, 
 		const std::function <bool (std::vector<input_t>::iterator, std::vector<input_t>::iterator, std::vector<input_t>::iterator)>& selection);
@@ -129,6 +270,99 @@ class Run
 	
 };
 
+/* The templated queries. These have to be in the header so each call site
+ * gets its own copy with the callables inlined. */
+template <class Expr, class Sel>
+TH1D Run::getCoincHist(const Expr& expr, const Sel& selection) {
+	this->loadCoinc();
+	std::vector<double> points;
+	for(auto it = coinc.begin(); it < coinc.end(); it++) {
+		if(selection(*it)) {
+			points.push_back(expr(*it));
+		}
+	}
+	return fillUnitHist(points, 10);
+}
+
+template <class Expr, class Sel>
+TH1D Run::getHist(const Expr& expr, const Sel& selection) {
+	/* in streaming mode we never load the data */
+	if(this->openStream()) {
+		return this->getHistStream(expr, selection);
+	}
+	std::vector<double> points;
+	if(this->loadData()) {
+		std::vector<input_t> scratch;
+		const input_t* block;
+		long first = 0;
+		long num;
+		long i;
+		while((num = this->getEventBlock(first, scratch, block)) > 0) {
+			for(i = 0; i < num; i++) {
+				if(selection(block[i])) {
+					points.push_back(expr(block[i]));
+				}
+			}
+			first += num;
+		}
+	}
+	return fillUnitHist(points, 0);
+}
+
+template <class Expr, class Sel>
+std::vector<input_t> Run::getCoincCounts(const Expr& expr, const Sel& selection) {
+	this->loadCoinc();
+	std::vector<input_t> transformed;
+	for(auto it = coinc.begin(); it < coinc.end(); it++) {
+		if(selection(*it)) {
+			transformed.push_back(expr(*it));
+		}
+	}
+	return transformed;
+}
+
+template <class Expr, class Sel>
+std::vector<input_t> Run::getCounts(const Expr& expr, const Sel& selection) {
+	/* in streaming mode we never load the data */
+	if(this->openStream()) {
+		return this->getCountsStream(expr, selection);
+	}
+	std::vector<input_t> transformed;
+	if(!this->loadData()) {
+		return transformed;
+	}
+	std::vector<input_t> scratch;
+	const input_t* block;
+	long first = 0;
+	long num;
+	long i;
+	while((num = this->getEventBlock(first, scratch, block)) > 0) {
+		for(i = 0; i < num; i++) {
+			if(selection(block[i])) {
+				transformed.push_back(expr(block[i]));
+			}
+		}
+		first += num;
+	}
+	return transformed;
+}
+
+template <class Expr, class Sel>
+std::vector<double> Run::getPhotonTracesVect(int pmt, const Expr& expr, const Sel& selection) {
+	this->loadCoinc();
+	const coincHits& photonHits = pmt == 1 ? pmtACoincHits : pmtBCoincHits;
+	std::vector<double> mapped;
+	std::vector<input_t> trace;
+	long k;
+	for(k = 0; k < photonHits.size(); k++) {
+		this->copyPhotonTrace(pmt, k, trace);
+		if(selection(trace)) {
+			mapped.push_back(expr(trace));
+		}
+	}
+	return mapped;
+}
+
 /* Pulling out the old commented code and putting it here for later:
  * //	double vUp;  //Holds the realtime of the vanadium going up for counting in the long run
 //	double tdUp;
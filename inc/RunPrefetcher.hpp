@@ -0,0 +1,50 @@
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include "Run.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class loads runs ahead of the analysis, so reading and decoding the next runs (often off
+	a slow external drive) overlaps with the analysis of the current one instead of taking turns.
+
+	The constructor takes the number of runs, how many loaded runs may wait at most (the depth),
+	and a function that builds Run k. A background thread builds the runs in order and reads each
+	one in (Run::preload), then waits whenever depth of them are ready and not yet taken. The
+	method next hands them out in the same order, waiting for the next one if it isn't ready yet,
+	and returns NULL once every run has been handed out. The caller owns (and deletes) each Run it
+	gets. At most depth runs wait in the queue, with one more being loaded and whatever the caller
+	still holds, so memory is set by the depth.
+
+	The runs are loaded on another thread, so ROOT is made ready for threads first
+	(Run::initThreadSafety). Destroying the prefetcher early stops the loader after the run it is
+	on and frees the runs that were never taken.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class RunPrefetcher
+{
+	private:
+	long numRuns;
+	int depth;
+	std::function <Run* (long)> open;
+
+	/* runs loaded and waiting to be taken, in order */
+	std::deque<Run*> ready;
+	long numTaken;
+	bool stopping;
+	std::mutex queueLock;
+	std::condition_variable queueChanged;
+	std::thread loader;
+
+	void loadRuns();
+
+	public:
+	RunPrefetcher(long numRuns, int depth, const std::function <Run* (long)>& open);
+	~RunPrefetcher();
+	Run* next();
+};
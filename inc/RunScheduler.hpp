@@ -0,0 +1,40 @@
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class runs a list of jobs (one per run, for DBHandler) on a pool of threads.
+
+	The constructor takes the number of threads, where 0 means one per core. The method run takes
+	a cost for each job (for runs, the size of the file) and a function that does job k. Jobs are
+	handed out biggest first: they are sorted by cost and dealt round robin onto one queue per
+	thread. Each thread works through its own queue from the front, and once it is empty steals
+	from the back of the queue with the most jobs left, so a few long runs near the end don't
+	leave the other threads idle.
+
+	Jobs finish in whatever order they finish in, so they should write their results to slot k of
+	something the caller made beforehand. With one thread (or one job) the jobs are just done in
+	order, on the calling thread.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class RunScheduler
+{
+	private:
+	int numThreads;
+
+	/* one queue of job numbers per thread, biggest first */
+	std::vector<std::deque<long> > queues;
+	std::mutex queueLock;
+
+	bool takeJob(int thread, long& job);
+
+	public:
+	RunScheduler(int numThreads);
+	void run(const std::vector<double>& costs, const std::function <void (long)>& job);
+	int getNumThreads();
+};
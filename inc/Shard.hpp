@@ -0,0 +1,55 @@
+#include <vector>
+#include <string>
+#include "stdio.h"
+#include "Run.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class splits a campaign of runs into N shards, so it can be done by N separate processes
+	(on one machine or several) and put back together afterwards.
+
+	A shard is written i/N (i from 0 to N-1) and parsed with parse, e.g. from --shard 2/8. Shard i
+	owns every run whose run number is i mod N. That only depends on the run number, so each
+	process picks the same runs no matter where it got the run list or what order it came in. The
+	default shard is 0/1, the whole campaign, and then nothing below changes any output.
+
+	A sharded process tags what it prints so the pieces can be merged back in order:
+		Shard - i/N					once, at the start (printHeader)
+		ShardRun - k,runNo			before each run it does, k being the run's place in the full
+									list (printRun). The Data - lines that follow belong to it.
+		Measurement - k,runNo,val,err	for each measurement it returns (printMeasurement)
+	The ROOT files written for each run are named by run number, so shards never write the same
+	one. Anything summed over the runs should be saved under a name of its own in each shard.
+
+	The merge (mergeTables, mergeHistograms, and the ShardMerger program) reads the logs or ROOT
+	files of all N shards. The tables come out in the order of the full run list: the Data - and
+	FillData - lines of each run, then the Measurement - lines, which make up the same measurement
+	vector a single process would return. The tables are checked for exactly one log per shard.
+	Histograms of the same name are added bin by bin. For the Data - lines to stay with their
+	run, a shard should do its runs one at a time (more shards instead of more run threads).
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class Shard
+{
+	private:
+	int index;
+	int count;
+
+	public:
+	Shard();
+	Shard(int index, int count);
+	bool parse(const char* spec);
+	bool owns(int runNo);
+	bool isWhole();
+	int getIndex();
+	int getCount();
+	void printHeader();
+	void printRun(long position, int runNo);
+	void printMeasurement(long position, int runNo, measurement result);
+
+	static bool mergeTables(const std::vector<std::string>& logNames, FILE* out);
+	static bool mergeHistograms(const std::vector<std::string>& fileNames, const char* outName);
+};
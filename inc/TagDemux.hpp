@@ -0,0 +1,52 @@
+#include <vector>
+#include <stdint.h>
+#include "Run.hpp"
+#include "DeadtimeVeto.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class decodes the raw mcs_events stream into channels, the way readDataRoot always has.
+
+	Channels 3 and 4 carry multiplexed tag bits: the tag bits on a ch3 event pick out ch6-ch9, and
+	the ones on a ch4 event pick out ch10-ch11. When there are zero, two or three tag bits we look
+	back at the last event of the same group to sort out which channel it really was. Every decoded
+	event then goes through the DeadtimeVeto given to the constructor (in readDataRoot, ch5 events
+	within 10us of the last ch5 are dropped, and a ch9 within 10us of the last ch9 marks that
+	earlier one as a ch19).
+
+	Instead of scanning backwards through the output for each of these, the decoder remembers the
+	last event of each group as it goes, so every event costs the same no matter how noisy the run
+	is. The lookbacks are copies of the events as they were decoded, so the veto relabelling an
+	earlier event doesn't change what the ch3/ch4 lookbacks see.
+
+	The method push decodes one raw event (in tree order) and appends whatever it turns into to
+	the output vector given to the constructor. Given a block of raw events it decodes them all,
+	which saves a call per event.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class TagDemux
+{
+	private:
+	std::vector<input_t>& out;
+	DeadtimeVeto& veto;
+	long numRead;
+
+	/* the last event of each lookback group. ch3 looks back to ch3 or
+	 * ch>5, ch4 looks back to ch4 or ch>9. */
+	input_t lastGroup3;
+	input_t lastGroup4;
+	bool haveGroup3;
+	bool haveGroup4;
+
+	void append(input_t event);
+	int numBits(uint32_t i);
+
+	public:
+	TagDemux(std::vector<input_t>& out, DeadtimeVeto& veto);
+	void push(input_t event);
+	void push(const std::vector<input_t>& block);
+	long getNumRead();
+};
@@ -0,0 +1,53 @@
+#include <vector>
+#include "TTree.h"
+#include "TLeaf.h"
+#include "TBranch.h"
+#include "Run.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	This class reads the MCS event trees in blocks instead of one GetEntry() per event.
+
+	On construction it finds the time, realtime, channel (or ch) and tag leaves, binds them to an
+	internal input_t and puts only the branches holding those leaves into a large TTreeCache. The
+	cache then pulls whole baskets off disk in one go, and with implicit MT enabled ROOT unzips
+	those baskets on its thread pool.
+
+	The method readBlock appends one cluster's worth of events (the natural basket boundary of
+	the tree) to the given vector and returns how many it added, so 0 means we are done. Given a
+	maxEvents it stops there, partway through a cluster if need be, and picks up from there next
+	time. The vector grows geometrically, but presizing it saves the copies.
+
+	The method readAll presizes the output from GetEntries() and slurps the whole tree.
+
+	The static method enableImplicitMT turns on ROOT's multithreaded basket decompression. Call
+	it once at startup, before any files are opened.
+	------------------------------------------------------------------------------------------------	*/
+
+#pragma once
+
+class TreeReader
+{
+	private:
+	TTree* tree;
+	input_t event;
+	std::vector<TBranch*> branches;
+	Long64_t numEntries;
+	Long64_t nextEntry;
+	Long64_t clusterEnd;
+	TTree::TClusterIterator clusters;
+	bool valid;
+
+	void bindLeaf(const char* name, void* address);
+
+	public:
+	TreeReader(TTree* tree);
+	bool isValid();
+	Long64_t getEntries();
+	long readBlock(std::vector<input_t>& block);
+	long readBlock(std::vector<input_t>& block, long maxEvents);
+	long readAll(std::vector<input_t>& out);
+
+	static void enableImplicitMT(int nThreads);
+};
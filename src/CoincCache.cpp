@@ -0,0 +1,171 @@
+#include "../inc/CoincCache.hpp"
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Sidecar cache of coincidence results. See CoincCache.hpp for the file layout.
+	------------------------------------------------------------------------------------------------	*/
+
+static const char cacheMagic[8] = {'M', 'C', 'S', 'C', 'O', 'I', 'N', '\0'};
+
+bool CoincCache::enabled = false;
+
+/* Turn the cache on or off for all Runs */
+void CoincCache::setEnabled(bool enable) {
+	enabled = enable;
+}
+bool CoincCache::isEnabled() {
+	return enabled;
+}
+
+/* The cache lives next to the ROOT file, one per tree and setting */
+std::string CoincCache::cachePath(const coincCacheKey& key) {
+	char suffix[128];
+	snprintf(suffix, sizeof(suffix), ".%s.%d_%d_%d_%d.%s", key.treeName, key.coincWindow, key.peSumWindow,
+			 key.peSum, key.coincMode, key.streamed ? "scoc" : "coc");
+	return std::string(key.fileName) + suffix;
+}
+
+/* Fill in everything in the header that identifies the cache, from the
+ * key and the source file as it is now */
+bool CoincCache::stampHeader(const coincCacheKey& key, coincCacheHeader& header) {
+	struct stat st;
+	if(stat(key.fileName, &st) != 0) {
+		return false;
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.formatVersion = COINCCACHEVERSION;
+	header.decoderVersion = DECODERVERSION;
+	header.sourceSize = (uint64_t)st.st_size;
+	header.sourceMtime = (int64_t)st.st_mtime;
+	header.runNo = key.runNo;
+	header.coincWindow = key.coincWindow;
+	header.peSumWindow = key.peSumWindow;
+	header.peSum = key.peSum;
+	header.coincMode = key.coincMode;
+	header.eventSize = sizeof(input_t);
+	return true;
+}
+
+/* Read n items of a vector in from a cache file */
+template <class T>
+static bool readArray(FILE* in, std::vector<T>& items, uint64_t n) {
+	items.resize(n);
+	return n == 0 || fread(items.data(), sizeof(T), n, in) == n;
+}
+
+/* Write a vector out to a cache file */
+template <class T>
+static bool writeArray(FILE* out, const std::vector<T>& items) {
+	return items.empty() || fwrite(items.data(), sizeof(T), items.size(), out) == items.size();
+}
+
+/* Try to fill found from a cache file. Returns false (and leaves found
+ * alone) if there is no cache or it doesn't match the key and source. */
+bool CoincCache::load(const coincCacheKey& key, coincResults& found) {
+	if(!enabled || key.fileName == NULL) {
+		return false;
+	}
+	coincCacheHeader stamp;
+	if(!stampHeader(key, stamp)) {
+		return false;
+	}
+
+	std::string path = cachePath(key);
+	FILE* in = fopen(path.c_str(), "rb");
+	if(in == NULL) {
+		return false;
+	}
+	struct stat st;
+	coincCacheHeader header;
+	if(fstat(fileno(in), &st) != 0 || fread(&header, sizeof(header), 1, in) != 1) {
+		fclose(in);
+		return false;
+	}
+
+	/* check that the cache is for this source, decoder and setting, and
+	 * that it's all there */
+	bool good = memcmp(header.magic, stamp.magic, sizeof(stamp.magic)) == 0
+		&& header.formatVersion == stamp.formatVersion
+		&& header.decoderVersion == stamp.decoderVersion
+		&& header.sourceSize == stamp.sourceSize
+		&& header.sourceMtime == stamp.sourceMtime
+		&& header.runNo == stamp.runNo
+		&& header.coincWindow == stamp.coincWindow
+		&& header.peSumWindow == stamp.peSumWindow
+		&& header.peSum == stamp.peSum
+		&& header.coincMode == stamp.coincMode
+		&& header.eventSize == stamp.eventSize
+		&& (uint64_t)st.st_size == sizeof(header) + (header.numCoinc + header.numCopied)*sizeof(input_t)
+			+ (header.numOffsetsA + header.numHitsA + header.numOffsetsB + header.numHitsB)*sizeof(uint32_t);
+
+	coincResults cached = found;
+	good = good
+		&& readArray(in, cached.coinc, header.numCoinc)
+		&& readArray(in, cached.pmtAHits.offsets, header.numOffsetsA)
+		&& readArray(in, cached.pmtAHits.index, header.numHitsA)
+		&& readArray(in, cached.pmtBHits.offsets, header.numOffsetsB)
+		&& readArray(in, cached.pmtBHits.index, header.numHitsB)
+		&& readArray(in, cached.copiedHits, header.numCopied);
+	fclose(in);
+	if(!good) {
+		printf("Ignoring stale coincidence cache %s\n", path.c_str());
+		return false;
+	}
+
+	/* the finder fills the phs with the number of hits on each PMT */
+	long k;
+	for(k = 0; k < cached.pmtAHits.size(); k++) {
+		cached.phsA.fill(cached.pmtAHits.numHits(k));
+		cached.phsB.fill(cached.pmtBHits.numHits(k));
+	}
+	std::swap(found, cached);
+	printf("Loaded %lu coincidences from cache %s\n", (unsigned long)header.numCoinc, path.c_str());
+	return true;
+}
+
+/* Write what the finder found out as the cache for this key */
+bool CoincCache::save(const coincCacheKey& key, const coincResults& found) {
+	if(!enabled || key.fileName == NULL) {
+		return false;
+	}
+
+	/* stamp the header */
+	coincCacheHeader header;
+	if(!stampHeader(key, header)) {
+		return false;
+	}
+	header.numCoinc = found.coinc.size();
+	header.numOffsetsA = found.pmtAHits.offsets.size();
+	header.numHitsA = found.pmtAHits.index.size();
+	header.numOffsetsB = found.pmtBHits.offsets.size();
+	header.numHitsB = found.pmtBHits.index.size();
+	header.numCopied = found.copiedHits.size();
+
+	/* write to a temporary file and move it into place when complete */
+	std::string path = cachePath(key);
+	char tmpPath[512];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp%d", path.c_str(), (int)getpid());
+	FILE* out = fopen(tmpPath, "wb");
+	if(out == NULL) {
+		fprintf(stderr, "Could not write coincidence cache %s\n", tmpPath);
+		return false;
+	}
+	bool good = fwrite(&header, sizeof(header), 1, out) == 1
+		&& writeArray(out, found.coinc)
+		&& writeArray(out, found.pmtAHits.offsets)
+		&& writeArray(out, found.pmtAHits.index)
+		&& writeArray(out, found.pmtBHits.offsets)
+		&& writeArray(out, found.pmtBHits.index)
+		&& writeArray(out, found.copiedHits);
+	good = (fclose(out) == 0) && good;
+	if(!good || rename(tmpPath, path.c_str()) != 0) {
+		fprintf(stderr, "Could not write coincidence cache %s\n", path.c_str());
+		unlink(tmpPath);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,196 @@
+#include "../inc/CoincFinder.hpp"
+#define NANOSECOND .000000001
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Incremental coincidence finding. See CoincFinder.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Same parameters as the Run constructor */
+CoincFinder::CoincFinder(int coincWindow, int peSumWindow, int peSum, int coincMode) {
+	this->coincWindow = coincWindow;
+	this->peSumWindow = peSumWindow;
+	this->peSum = peSum;
+	this->coincMode = coincMode;
+	coincTicks = tickClock::window(coincWindow*NANOSECOND);
+	tailTicks = tickClock::window(peSumWindow*NANOSECOND);
+	ticks = true;
+	numCoinc = 0;
+	this->restart();
+	phsA = FastHist("phsA", "phsA", 100, 0, 100);
+	phsB = FastHist("phsB", "phsB", 100, 0, 100);
+}
+
+/* Take the next event (in time order) and decide every start event we
+ * can. Returns the number of coincidences found. */
+int CoincFinder::push(const input_t& event) {
+
+	/* for coincidences we only want dagger hits */
+	if(event.ch != 1 && event.ch != 2) {
+		return 0;
+	}
+	/* once we switch to realtimes, the searches so far don't hold */
+	if(ticks && event.realtime != ((double)event.time) * CLKTONS) {
+		ticks = false;
+		this->restart();
+	}
+	window.push_back(event);
+	return this->decide(false);
+}
+
+/* No more events are coming, so decide everything left */
+int CoincFinder::flush() {
+	return this->decide(true);
+}
+
+/* Whether later is outside the coincidence window (or the peSum window, if
+ * tail is set) from earlier. We compare clock ticks like the finders do, 
+ * unless we've been handed an event whose realtime isn't from the clock. */
+bool CoincFinder::apart(const input_t& earlier, const input_t& later, bool tail) {
+	if(ticks) {
+		return (long long)later.time - (long long)earlier.time > (tail ? tailTicks : coincTicks);
+	}
+	return later.realtime - earlier.realtime > (tail ? peSumWindow : coincWindow)*NANOSECOND;
+}
+
+/* Drop the front start event. The search positions move with the window,
+ * and stay where they are for the next start event (see decide). */
+void CoincFinder::popFront() {
+	if(counted > 0) {
+		ch1Counted -= window.front().ch == 1 ? 1 : 0;
+		counted--;
+	}
+	window.pop_front();
+	cur--;
+	tailEnd--;
+}
+
+/* Decide start events from the front of the window, the same way the
+ * finders do. Unless last is set, we stop at the first start event whose
+ * coincidence window or tail is still open.
+ *
+ * Like the finders' pointers, cur and tailEnd only move forward through
+ * the events, so each push costs about the same however long the window
+ * is. The events between the start and cur are all on the start's channel
+ * and inside its window, which stays true for the next start event if
+ * that's one of them. Events before tailEnd are inside the tail of the
+ * next start event too: the fixed tail is measured from a later start, and
+ * the moving tail only depends on the gaps between events. */
+int CoincFinder::decide(bool last) {
+	int numFound = 0;
+	long size;
+
+	while((size = window.size()) > 0) {
+		const input_t& start = window[0];
+
+		/* search forwards for an event on the other channel inside the
+		 * coincidence window */
+		bool closed = false;
+		if(cur < 1) {
+			cur = 1;
+		}
+		for(; cur < size; cur++) {
+			if(this->apart(start, window[cur], false)) {
+				closed = true;
+				break;
+			}
+			if(window[cur].ch != start.ch) {
+				break;
+			}
+		}
+		if(cur == size && !last) {
+			return numFound;
+		}
+
+		/* no coincidence for this start event */
+		if(cur == size || closed) {
+			this->popFront();
+			continue;
+		}
+
+		/* integrate the tail end */
+		if(tailEnd < cur+1) {
+			tailEnd = cur+1;
+		}
+		for(; tailEnd < size; tailEnd++) {
+			if(coincMode == 1 && this->apart(start, window[tailEnd], true)) {
+				break;
+			}
+			if(coincMode != 1 && this->apart(window[tailEnd-1], window[tailEnd], true)) {
+				break;
+			}
+		}
+		if(tailEnd == size && !last) {
+			return numFound;
+		}
+
+		/* check to see if we've found a neutron. Every event up to the
+		 * end of the tail is a dagger hit. */
+		if(coincMode == 1 ? tailEnd > peSum : tailEnd >= peSum) {
+			for(; counted < tailEnd; counted++) {
+				ch1Counted += window[counted].ch == 1 ? 1 : 0;
+			}
+			found.push_back(start);
+			phsA.fill(ch1Counted);
+			phsB.fill(tailEnd - ch1Counted);
+			numCoinc++;
+			numFound++;
+
+			/* put deadtime on counted neutrons */
+			window.erase(window.begin(), window.begin() + tailEnd);
+			this->restart();
+		}
+		else {
+			this->popFront();
+		}
+	}
+	return numFound;
+}
+
+/* Start the searches over from the front of the window */
+void CoincFinder::restart() {
+	cur = 1;
+	tailEnd = 0;
+	counted = 0;
+	ch1Counted = 0;
+}
+
+/* Hand out the oldest coincidence found, if there is one */
+bool CoincFinder::next(input_t& coinc) {
+	if(found.empty()) {
+		return false;
+	}
+	coinc = found.front();
+	found.pop_front();
+	return true;
+}
+
+/* Forget everything, to start on a new run */
+void CoincFinder::reset() {
+	window.clear();
+	found.clear();
+	ticks = true;
+	numCoinc = 0;
+	this->restart();
+	phsA.reset();
+	phsB.reset();
+}
+
+/* How many coincidences have been found so far */
+long CoincFinder::getNumCoinc() {
+	return numCoinc;
+}
+
+/* How many events are being held for undecided start events */
+long CoincFinder::getWindowSize() {
+	return window.size();
+}
+
+TH1D CoincFinder::getphsA() {
+	return phsA.toTH1D();
+}
+
+TH1D CoincFinder::getphsB() {
+	return phsB.toTH1D();
+}
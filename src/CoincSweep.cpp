@@ -0,0 +1,218 @@
+#include "../inc/CoincSweep.hpp"
+#include <algorithm>
+#define NANOSECOND .000000001
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Single-pass coincidence finding for many finder settings. See CoincSweep.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* The shared tail for a mode and peSumWindow, added if it's new */
+int CoincSweep::findTail(int coincMode, int peSumWindow) {
+	int i;
+	for(i = 0; i < (int)tails.size(); i++) {
+		if(tails[i].coincMode == coincMode && tails[i].peSumWindow == peSumWindow) {
+			return i;
+		}
+	}
+	sweepTail tail;
+	tail.coincMode = coincMode;
+	tail.peSumWindow = peSumWindow;
+	tail.end = 0;
+	tails.push_back(tail);
+	return tails.size() - 1;
+}
+
+/* Add a setting to sweep, with the same parameters as the Run constructor.
+ * Returns its number. */
+int CoincSweep::addSetting(int coincWindow, int peSumWindow, int peSum, int coincMode) {
+	sweepQuery query;
+	query.setting = sweepSetting {coincWindow, peSumWindow, peSum, coincMode};
+	query.tail = this->findTail(coincMode, peSumWindow);
+	query.next = 0;
+	query.numCoinc = 0;
+	query.keep = false;
+	query.scan = NULL;
+	queries.push_back(query);
+	return queries.size() - 1;
+}
+
+/* Add every combination of the values given. The settings are numbered
+ * with the last list changing fastest, starting from the number returned. */
+int CoincSweep::addGrid(const std::vector<int>& coincWindows, const std::vector<int>& peSumWindows, const std::vector<int>& peSums, const std::vector<int>& coincModes) {
+	int first = queries.size();
+	for(auto cw = coincWindows.begin(); cw < coincWindows.end(); cw++) {
+		for(auto psw = peSumWindows.begin(); psw < peSumWindows.end(); psw++) {
+			for(auto ps = peSums.begin(); ps < peSums.end(); ps++) {
+				for(auto mode = coincModes.begin(); mode < coincModes.end(); mode++) {
+					this->addSetting(*cw, *psw, *ps, *mode);
+				}
+			}
+		}
+	}
+	return first;
+}
+
+/* Keep the coincidences a setting finds, not just count them */
+void CoincSweep::keepCoinc(int setting) {
+	queries[setting].keep = true;
+}
+
+/* Hand every coincidence a setting finds to scan as well */
+void CoincSweep::setScan(int setting, EventScan* scan) {
+	queries[setting].scan = scan;
+}
+
+/* Search the daggers of a run (in time order) for every setting at once,
+ * comparing clock ticks if we can, like the finders */
+template <class Events>
+void CoincSweep::search(const Events& evts) {
+	if(realtimeFromTicks(evts)) {
+		this->searchClock<tickClock>(evts);
+	}
+	else {
+		this->searchClock<realtimeClock>(evts);
+	}
+}
+
+/* The search itself, with times compared by Clock */
+template <class Clock, class Events>
+void CoincSweep::searchClock(const Events& evts) {
+	long size = evts.size();
+	long i;
+	long opp = 0;
+
+	/* the settings with the widest coincidence window come first, so we
+	 * can stop at the first one too narrow for a start event */
+	std::vector<int> order(queries.size());
+	int q;
+	for(q = 0; q < (int)queries.size(); q++) {
+		order[q] = q;
+	}
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b)->bool{
+		return queries[a].setting.coincWindow > queries[b].setting.coincWindow;
+	});
+	
+	/* positions are in this run, so start everything from the front */
+	for(auto it = tails.begin(); it < tails.end(); it++) {
+		(*it).end = 0;
+	}
+	for(auto it = queries.begin(); it < queries.end(); it++) {
+		(*it).next = 0;
+	}
+
+	/* every window in the clock's units */
+	std::vector<typename Clock::span> coincSpans(queries.size());
+	std::vector<typename Clock::span> tailSpans(tails.size());
+	for(q = 0; q < (int)queries.size(); q++) {
+		coincSpans[q] = Clock::window(queries[q].setting.coincWindow*NANOSECOND);
+	}
+	for(q = 0; q < (int)tails.size(); q++) {
+		tailSpans[q] = Clock::window(tails[q].peSumWindow*NANOSECOND);
+	}
+
+	for(i = 0; i < size; i++) {
+		int ch = eventCh(evts, i);
+		typename Clock::span startTime = Clock::at(evts, i);
+
+		/* find the first later event on the other channel. It only has
+		 * to be looked for again when the channel changes. */
+		if(opp <= i || (opp < size && eventCh(evts, opp) == ch)) {
+			for(opp = i+1; opp < size; opp++) {
+				if(eventCh(evts, opp) != ch) {
+					break;
+				}
+			}
+		}
+		if(opp == size) {
+			continue;
+		}
+		typename Clock::span oppTime = Clock::at(evts, opp);
+
+		for(q = 0; q < (int)order.size(); q++) {
+			sweepQuery& query = queries[order[q]];
+
+			/* no coincidence for this setting or any narrower one */
+			if(oppTime - startTime > coincSpans[order[q]]) {
+				break;
+			}
+			/* still in the deadtime of this setting's last neutron */
+			if(i < query.next) {
+				continue;
+			}
+			if(query.setting.coincMode != 1 && query.setting.coincMode != 2) {
+				continue;
+			}
+
+			/* integrate the tail end, from where the last start event
+			 * that needed this tail left off */
+			sweepTail& tail = tails[query.tail];
+			if(tail.end < opp+1) {
+				tail.end = opp+1;
+			}
+			if(tail.coincMode == 1) {
+				while(tail.end < size && !(Clock::at(evts, tail.end) - startTime > tailSpans[query.tail])) {
+					tail.end++;
+				}
+			}
+			else {
+				while(tail.end < size && !(Clock::at(evts, tail.end) - Clock::at(evts, tail.end-1) > tailSpans[query.tail])) {
+					tail.end++;
+				}
+			}
+
+			/* every dagger event from the start to the end of the tail
+			 * counts towards the PE sum */
+			long peSum = tail.end - i;
+			if(query.setting.coincMode == 1 ? peSum > query.setting.peSum : peSum >= query.setting.peSum) {
+				this->push(order[q], eventAt(evts, i));
+				query.next = tail.end;
+			}
+		}
+	}
+}
+
+/* Record one coincidence found for a setting */
+void CoincSweep::push(int setting, const input_t& coinc) {
+	sweepQuery& query = queries[setting];
+	query.numCoinc++;
+	if(query.keep) {
+		query.coinc.push_back(coinc);
+	}
+	if(query.scan != NULL) {
+		query.scan->push(coinc);
+	}
+}
+
+/* Clear the results to sweep again. Until then, the coincidences of every
+ * run swept add up. Scans are left to their owners. */
+void CoincSweep::reset() {
+	for(auto it = queries.begin(); it < queries.end(); it++) {
+		(*it).numCoinc = 0;
+		(*it).coinc.clear();
+	}
+}
+
+int CoincSweep::getNumSettings() {
+	return queries.size();
+}
+
+/* The parameters of a setting */
+const sweepSetting& CoincSweep::getSetting(int setting) {
+	return queries[setting].setting;
+}
+
+/* How many coincidences a setting found */
+long CoincSweep::getNumCoinc(int setting) {
+	return queries[setting].numCoinc;
+}
+
+/* The coincidences found by a setting we were asked to keep them for */
+const std::vector<input_t>& CoincSweep::getCoinc(int setting) {
+	return queries[setting].coinc;
+}
+
+/* runs are swept over their daggers, in either storage */
+template void CoincSweep::search(const EventSubset<std::vector<input_t> >& evts);
+template void CoincSweep::search(const EventSubset<EventStore>& evts);
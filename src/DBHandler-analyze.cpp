@@ -1,5 +1,6 @@
 #include "../inc/DBHandler.hpp"
 #include "../inc/Run.hpp"
+#include <mutex>
 
 /*	------------------------------------------------------------------------------------------------
 	Author: Nathan B. Callahan
@@ -10,7 +11,7 @@
 
 
 /* Accept a function which will return a vector<measurement> and will be evaluated for each run. 
- * We will return the vector<measurement> results. */
+ * We will return the vector<measurement> results, in the order of the runs. */
 std::vector<measurement> DBHandler::getMeasurements(const std::function <measurement (Run*)>& analyzer) {
 	std::vector<measurement> results; 
 	
@@ -19,34 +20,62 @@ std::vector<measurement> DBHandler::getMeasurements(const std::function <measure
 		this->getRuns();
 	}
 	
-	/* Loop through the runs. Begin by initializing loop vars */
-	auto it = runs.begin();
-	char runName[256];
-	auto bodiesIt = runBodies.begin();
+	/* each run fills its own slot, so they can be done in any order */
+	std::vector<measurement> measured(runs.size());
+	std::vector<char> found(runs.size(), 0);
 	
-	/* Create the filename and the runobject. Loop through the total number of runs. */
-	for(it = runs.begin(); it < runs.end(); it++) {	
-		sprintf(runName, "/media/frank/FreeAgentDrive/UCNtau/2017/processed_output/processed_output_%05d.root", (*it));
-		printf("Opening Run %05d\n", (*it));
-		Run run(this->coincWindow, this->peSumWindow, this->peSum, *it, coincMode, *bodiesIt);
+	/* Create the filename and the runobject for each run. */
+	this->forEachRun([&](long k, Run* run) {
 		printf("Set coinc mode %d\n", coincMode);
-		bodiesIt++;
 		
 		/* skip any nonexistent runs */
-		if(!run.exists()) {
-			printf("Skipping Run %05d\n", (*it));
-			continue;
+		if(!run->exists()) {
+			printf("Skipping Run %05d\n", runs[k]);
+			return;
 		}
 		
 		/* call the analyzer on our run, and call back the results */
-		measurement mes = analyzer(&run); 
-		results.push_back(mes);
+		measured[k] = analyzer(run); 
+		found[k] = 1;
+	});
+	
+	/* put the results back in the order of the runs */
+	size_t k;
+	for(k = 0; k < runs.size(); k++) {
+		if(found[k]) {
+			results.push_back(measured[k]);
+			shard.printMeasurement(runPositions[k], runs[k], measured[k]);
+		}
 	}
-	
 	return results;
 	
 }
 
+/* One run's histogram, or the sum of a block of runs' histograms: the bin
+ * contents and squared errors, under and overflow included. */
+struct histSum {
+	std::vector<double> contents;
+	std::vector<double> errors2;
+	double entries;
+};
+
+/* Add the sum of the next block of runs onto this one */
+static void addHistSum(histSum& sum, const histSum& other) {
+	if(other.contents.empty()) {
+		return;
+	}
+	if(sum.contents.empty()) {
+		sum = other;
+		return;
+	}
+	size_t i;
+	for(i = 0; i < sum.contents.size(); i++) {
+		sum.contents[i] += other.contents[i];
+		sum.errors2[i] += other.errors2[i];
+	}
+	sum.entries += other.entries;
+}
+
 /* Accept a function which will return a TH1D (ROOT histogram) that will be 
  * evaluated for each run and summed. Returns the TH1D object. */
 TH1D DBHandler::sumHistograms(const std::function <TH1D (Run*)>& summer, int nbins, double low, double high) {
@@ -56,26 +85,84 @@ TH1D DBHandler::sumHistograms(const std::function <TH1D (Run*)>& summer, int nbi
 		this->getRuns();
 	}
 	
-	/* Loop through the runs. Begin by initializing loop vars */
-	auto it = runs.begin();
-	char runName[256];
-	int i;
-	
 	/* Initialize our histogram. The DBHandler::sumHistograms object has 
 	 * some argument inputs defining the bins. */
 	TH1D summedHist("summedHist", "summedHist", nbins, low, high); 
+	summedHist.SetDirectory(0);
+	summedHist.Sumw2();
+	
+	/* The runs are summed pairwise in a fixed tree over their place in the
+	 * list: at level s, the block of runs starting at base (a multiple of 2s)
+	 * is the block at base plus the block at base + s. Whichever half is done
+	 * second adds the other half in and carries on up, so blocks are summed
+	 * while other runs are still going, and the sum is the same whatever
+	 * order the runs finish in. */
+	long numRuns = runs.size();
+	std::vector<histSum> sums(numRuns);
+	std::vector<std::vector<char> > arrived;
+	long s;
+	for(s = 1; s < numRuns; s <<= 1) {
+		arrived.push_back(std::vector<char>((numRuns + 2*s - 1) / (2*s), 0));
+	}
+	std::mutex treeLock;
 	
-	for(it = runs.begin(); it < runs.end(); it++) {
-		sprintf(runName, "/media/frank/FreeAgentDrive/UCNtau/2016-2017/processed_output_%05d.root", (*it));
-		printf("Opening Run %05d\n", (*it));
-		Run run(this->coincWindow, this->peSumWindow, this->peSum, runName, coincMode);
+	this->runEach([&](long k) {
+		Run* run = this->openRun(k);
+		
+		/* skip any nonexistent runs, or histograms we can't add bin by bin */
+		if(!run->exists()) {
+			printf("Skipping Run %05d\n", runs[k]);
+		}
+		else {
+			TH1D hist = summer(run);
+			if(hist.GetNbinsX() != nbins || hist.GetXaxis()->GetXmin() != low || hist.GetXaxis()->GetXmax() != high) {
+				fprintf(stderr, "Error! Run %05d gave a histogram with other bins than (%d, %f, %f). Skipping it!\n", runs[k], nbins, low, high);
+			}
+			else {
+				histSum& leaf = sums[k];
+				leaf.contents.resize(nbins + 2);
+				leaf.errors2.resize(nbins + 2);
+				int i;
+				for(i = 0; i < nbins + 2; i++) {
+					leaf.contents[i] = hist.GetBinContent(i);
+					leaf.errors2[i] = pow(hist.GetBinError(i), 2.0);
+				}
+				leaf.entries = hist.GetEntries();
+			}
+		}
+		delete run;
 		
-		/* Apply the (histogram) summer function to our runs. Loop through 
-		 * and sum all histograms. */
-		TH1D hist = summer(&run); 
-		for(i = 0; i < nbins; i++) {
-			summedHist.Fill(i, hist.GetBinContent(i));
+		/* climb the tree as far as our half is the second one done */
+		long base = k;
+		long step;
+		int level;
+		for(step = 1, level = 0; step < numRuns; step <<= 1, level++) {
+			long node = base / (2*step);
+			base = node * 2*step;
+			if(base + step >= numRuns) {
+				continue;
+			}
+			{
+				std::lock_guard<std::mutex> lock(treeLock);
+				if(!arrived[level][node]) {
+					arrived[level][node] = 1;
+					return;
+				}
+			}
+			addHistSum(sums[base], sums[base + step]);
+			sums[base + step] = histSum();
 		}
+	});
+	
+	/* put the sum of every run into the histogram */
+	if(numRuns > 0 && !sums[0].contents.empty()) {
+		int i;
+		for(i = 0; i < nbins + 2; i++) {
+			summedHist.SetBinContent(i, sums[0].contents[i]);
+			summedHist.SetBinError(i, sqrt(sums[0].errors2[i]));
+		}
+		summedHist.ResetStats();
+		summedHist.SetEntries(sums[0].entries);
 	}
 	return summedHist;
 }
@@ -89,22 +176,10 @@ void DBHandler::foreach(const std::function <void (Run*)>& func) {
 		this->getRuns();
 	}
 	
-	/* Loop through the runs. Begin by initializing loop vars */
-	auto it = runs.begin();
-	char runName[256];
-	auto bodiesIt = runBodies.begin();
-	
-	/* Loop through the runs to act on each run with the requisite 
-	 * predefined function. */
-	for(it = runs.begin(); it < runs.end(); it++) {
-		sprintf(runName, "/media/frank/FreeAgentDrive/UCNtau/2017/processed_output/processed_output_%05d.root", (*it));
-		printf("Opening Run %05d\n", (*it));
-		
-		/* Create run Object */
-		Run run(this->coincWindow, this->peSumWindow, this->peSum, *it, coincMode, *bodiesIt);
-		bodiesIt++;
-		func(&run);
-	}
+	/* Act on each run with the requisite predefined function. */
+	this->forEachRun([&](long k, Run* run) {
+		func(run);
+	});
 }
 
 /* Extra lines of code that've been commented out
@@ -40,6 +40,10 @@ void DBHandler::getRuns() {
 		/* push onto runs and xs from the 0th and 1st columns of the row */
 		runs.push_back(atoi(row->GetField(0)));
 		runBodies.push_back(row->GetField(1));
+		runPositions.push_back(i);
 	}
 	serv->Close();
+	
+	/* drop the runs that belong to other shards */
+	this->keepShard();
 }
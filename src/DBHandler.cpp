@@ -1,4 +1,5 @@
 #include "../inc/DBHandler.hpp"
+#include <sys/stat.h>
 
 /*	------------------------------------------------------------------------------------------------
 	Author: Nathan B. Callahan
@@ -16,6 +17,8 @@ DBHandler::DBHandler(const char* sqlQuery, int coincWindow, int peSumWindow, int
 	this->peSumWindow = peSumWindow;
 	this->peSum = peSum;
 	this->coincMode = coincMode;
+	numThreads = 1;
+	prefetchDepth = 0;
 	this->getRuns();
 }
 
@@ -28,3 +31,97 @@ DBHandler::~DBHandler() {
 std::vector<double> DBHandler::getXs() {
 	return xs;
 }
+
+/* Do the runs on this many threads (0 for one per core) */
+void DBHandler::setThreads(int numThreads) {
+	this->numThreads = numThreads;
+}
+
+/* Do job(k) for each run k in the list, on our threads. The biggest run 
+ * files go first, so the long runs don't all end up at the end. */
+void DBHandler::runEach(const std::function <void (long)>& job) {
+	RunScheduler scheduler(numThreads);
+	std::vector<double> costs(runs.size(), 0.0);
+	char runName[256];
+	struct stat st;
+	size_t k;
+	for(k = 0; k < runs.size(); k++) {
+		snprintf(runName, sizeof(runName), runBodies[k].c_str(), runs[k]);
+		if(stat(runName, &st) == 0) {
+			costs[k] = (double)st.st_size;
+		}
+	}
+	
+	/* we're about to use ROOT from several threads. The runs already keep
+	 * the cores busy, so each run searches for coincidences on its own
+	 * thread instead of starting a thread per core of its own. */
+	if(scheduler.getNumThreads() > 1) {
+		Run::initThreadSafety();
+		scheduler.run(costs, [&job](long k) {
+			int previous = Run::setThreadCoincThreads(1);
+			job(k);
+			Run::setThreadCoincThreads(previous);
+		});
+		return;
+	}
+	scheduler.run(costs, job);
+}
+
+/* Read up to depth runs ahead while doing them one at a time. 0 turns the
+ * look-ahead off. */
+void DBHandler::setPrefetch(int depth) {
+	prefetchDepth = depth;
+}
+
+/* Build the Run for run k of the list */
+Run* DBHandler::openRun(long k) {
+	printf("Opening Run %05d\n", runs[k]);
+	return new Run(this->coincWindow, this->peSumWindow, this->peSum, runs[k], coincMode, runBodies[k]);
+}
+
+/* Do only the runs of one shard of the campaign */
+void DBHandler::setShard(const Shard& shard) {
+	this->shard = shard;
+	this->keepShard();
+}
+
+/* Drop the runs that aren't ours. runPositions keeps the place of each run 
+ * left in the full list. */
+void DBHandler::keepShard() {
+	size_t k;
+	size_t kept = 0;
+	for(k = 0; k < runs.size(); k++) {
+		if(!shard.owns(runs[k])) {
+			continue;
+		}
+		runs[kept] = runs[k];
+		runBodies[kept] = runBodies[k];
+		runPositions[kept] = runPositions[k];
+		kept++;
+	}
+	runs.resize(kept);
+	runBodies.resize(kept);
+	runPositions.resize(kept);
+}
+
+/* Call func(k, run) for each run k in the list. One at a time, the runs 
+ * can be read ahead by a RunPrefetcher. Otherwise they go to runEach. */
+void DBHandler::forEachRun(const std::function <void (long, Run*)>& func) {
+	if(prefetchDepth > 0 && numThreads == 1) {
+		RunPrefetcher prefetcher(runs.size(), prefetchDepth, [this](long k) { return this->openRun(k); });
+		long k;
+		for(k = 0; k < (long)runs.size(); k++) {
+			Run* run = prefetcher.next();
+			shard.printRun(runPositions[k], runs[k]);
+			func(k, run);
+			delete run;
+		}
+		return;
+	}
+	this->runEach([&](long k) {
+		Run* run = this->openRun(k);
+		shard.printRun(runPositions[k], runs[k]);
+		func(k, run);
+		delete run;
+	});
+}
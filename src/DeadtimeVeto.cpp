@@ -0,0 +1,60 @@
+#include "../inc/DeadtimeVeto.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Per-channel software deadtime veto. See DeadtimeVeto.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Start with no deadtimes on any channel */
+DeadtimeVeto::DeadtimeVeto() {
+}
+
+/* Set the deadtime (s) for a channel. Retriggers are dropped, or if relabel
+ * is a channel, the earlier event is moved to that channel. */
+void DeadtimeVeto::setDeadtime(int ch, double deadtime, int relabel) {
+	if(ch < 0) {
+		return;
+	}
+	if(ch >= (int)channels.size()) {
+		vetoChannel blank = {0.0, VETODROP, false, 0.0, -1, 0, 0};
+		channels.resize(ch + 1, blank);
+	}
+	channels[ch].deadtime = deadtime;
+	channels[ch].relabel = relabel;
+	channels[ch].active = true;
+}
+
+/* Number of events dropped on a channel */
+long DeadtimeVeto::getNumDropped(int ch) {
+	if(ch < 0 || ch >= (int)channels.size()) {
+		return 0;
+	}
+	return channels[ch].numDropped;
+}
+
+/* Number of events relabelled off of a channel */
+long DeadtimeVeto::getNumRelabelled(int ch) {
+	if(ch < 0 || ch >= (int)channels.size()) {
+		return 0;
+	}
+	return channels[ch].numRelabelled;
+}
+
+/* Print what the veto did to each channel with a deadtime */
+void DeadtimeVeto::printCounts() {
+	int ch;
+	for(ch = 0; ch < (int)channels.size(); ch++) {
+		if(!channels[ch].active) {
+			continue;
+		}
+		if(channels[ch].relabel == VETODROP) {
+			printf("Deadtime veto (%.1f us) on ch%d: dropped %ld events\n",
+				   channels[ch].deadtime * 1e6, ch, channels[ch].numDropped);
+		}
+		else {
+			printf("Deadtime veto (%.1f us) on ch%d: relabelled %ld events as ch%d\n",
+				   channels[ch].deadtime * 1e6, ch, channels[ch].numRelabelled, channels[ch].relabel);
+		}
+	}
+}
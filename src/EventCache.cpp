@@ -0,0 +1,139 @@
+#include "../inc/EventCache.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Sidecar cache of decoded events. See EventCache.hpp for the file layout.
+	------------------------------------------------------------------------------------------------	*/
+
+static const char cacheMagic[8] = {'M', 'C', 'S', 'E', 'V', 'T', 'C', '\0'};
+
+bool EventCache::enabled = false;
+
+/* Turn the cache on or off for all Runs */
+void EventCache::setEnabled(bool enable) {
+	enabled = enable;
+}
+bool EventCache::isEnabled() {
+	return enabled;
+}
+
+/* The cache lives next to the ROOT file, one per tree */
+std::string EventCache::cachePath(const char* fileName, const char* treeName) {
+	std::string path(fileName);
+	path += ".";
+	path += treeName;
+	path += ".evc";
+	return path;
+}
+
+/* Size and modification time of the source file, which we use to decide
+ * if a cache is stale. */
+bool EventCache::sourceStamp(const char* fileName, uint64_t* size, int64_t* mtime) {
+	struct stat st;
+	if(stat(fileName, &st) != 0) {
+		return false;
+	}
+	*size = (uint64_t)st.st_size;
+	*mtime = (int64_t)st.st_mtime;
+	return true;
+}
+
+/* Try to fill events from a cache file. Returns false (and leaves events
+ * alone) if there is no cache or it doesn't match the source. */
+bool EventCache::load(const char* fileName, const char* treeName, std::vector<input_t>& events) {
+	if(!enabled || fileName == NULL) {
+		return false;
+	}
+
+	/* we need the source stamp to validate against */
+	uint64_t size;
+	int64_t mtime;
+	if(!sourceStamp(fileName, &size, &mtime)) {
+		return false;
+	}
+
+	std::string path = cachePath(fileName, treeName);
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(eventCacheHeader)) {
+		close(fd);
+		return false;
+	}
+
+	/* map the whole file, we read it front to back */
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		return false;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	/* check that the cache is for this source and this decoder */
+	const eventCacheHeader* header = (const eventCacheHeader*)map;
+	bool good = memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) == 0
+		&& header->formatVersion == EVENTCACHEVERSION
+		&& header->decoderVersion == DECODERVERSION
+		&& header->sourceSize == size
+		&& header->sourceMtime == mtime
+		&& header->eventSize == sizeof(input_t)
+		&& (uint64_t)st.st_size == sizeof(eventCacheHeader) + header->numEvents*sizeof(input_t);
+
+	if(good) {
+		const input_t* first = (const input_t*)((const char*)map + sizeof(eventCacheHeader));
+		events.assign(first, first + header->numEvents);
+		printf("Loaded %lu events from cache %s\n", (unsigned long)header->numEvents, path.c_str());
+	}
+	else {
+		printf("Ignoring stale cache %s\n", path.c_str());
+	}
+	munmap(map, st.st_size);
+	return good;
+}
+
+/* Write events out as the cache for this file and tree */
+bool EventCache::save(const char* fileName, const char* treeName, const std::vector<input_t>& events) {
+	if(!enabled || fileName == NULL) {
+		return false;
+	}
+
+	/* stamp the header */
+	eventCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.formatVersion = EVENTCACHEVERSION;
+	header.decoderVersion = DECODERVERSION;
+	header.numEvents = events.size();
+	header.eventSize = sizeof(input_t);
+	if(!sourceStamp(fileName, &header.sourceSize, &header.sourceMtime)) {
+		return false;
+	}
+
+	/* write to a temporary file and move it into place when complete */
+	std::string path = cachePath(fileName, treeName);
+	char tmpPath[512];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp%d", path.c_str(), (int)getpid());
+	FILE* out = fopen(tmpPath, "wb");
+	if(out == NULL) {
+		fprintf(stderr, "Could not write event cache %s\n", tmpPath);
+		return false;
+	}
+	bool good = fwrite(&header, sizeof(header), 1, out) == 1;
+	if(good && !events.empty()) {
+		good = fwrite(events.data(), sizeof(input_t), events.size(), out) == events.size();
+	}
+	good = (fclose(out) == 0) && good;
+	if(!good || rename(tmpPath, path.c_str()) != 0) {
+		fprintf(stderr, "Could not write event cache %s\n", path.c_str());
+		unlink(tmpPath);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,98 @@
+#include "../inc/EventScan.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Batched single-pass count queries. See EventScan.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Set up an empty query */
+int EventScan::addQuery(int sink, const std::function <bool (input_t)>& selection) {
+	scanQuery query;
+	query.sink = sink;
+	query.selection = selection;
+	query.count = 0;
+	query.sum = 0.0;
+	query.hist = NULL;
+	queries.push_back(query);
+	return queries.size() - 1;
+}
+
+/* Keep the selected events, transformed */
+int EventScan::addVector(const std::function <bool (input_t)>& selection, const std::function <input_t (input_t)>& transform) {
+	int query = this->addQuery(SCANVECTOR, selection);
+	queries[query].transform = transform;
+	return query;
+}
+
+/* Count the selected events */
+int EventScan::addCounter(const std::function <bool (input_t)>& selection) {
+	return this->addQuery(SCANCOUNT, selection);
+}
+
+/* Sum value over the selected events */
+int EventScan::addSum(const std::function <bool (input_t)>& selection, const std::function <double (input_t)>& value) {
+	int query = this->addQuery(SCANSUM, selection);
+	queries[query].value = value;
+	return query;
+}
+
+/* Fill hist with value for the selected events */
+int EventScan::addHist(const std::function <bool (input_t)>& selection, const std::function <double (input_t)>& value, TH1D* hist) {
+	int query = this->addQuery(SCANHIST, selection);
+	queries[query].value = value;
+	queries[query].hist = hist;
+	return query;
+}
+
+/* Hand one event to every query */
+void EventScan::push(const input_t& event) {
+	for(auto it = queries.begin(); it < queries.end(); it++) {
+		if(!(*it).selection(event)) {
+			continue;
+		}
+		(*it).count++;
+		switch((*it).sink) {
+			case SCANVECTOR :
+				(*it).events.push_back((*it).transform(event));
+				break;
+			case SCANSUM :
+				(*it).sum += (*it).value(event);
+				break;
+			case SCANHIST :
+				(*it).hist->Fill((*it).value(event));
+				break;
+			default :
+				break;
+		}
+	}
+}
+
+/* Clear the results but keep the queries. Histograms belong to the
+ * caller and aren't touched. */
+void EventScan::reset() {
+	for(auto it = queries.begin(); it < queries.end(); it++) {
+		(*it).events.clear();
+		(*it).count = 0;
+		(*it).sum = 0.0;
+	}
+}
+
+int EventScan::getNumQueries() {
+	return queries.size();
+}
+
+/* The events kept by an addVector query */
+const std::vector<input_t>& EventScan::getEvents(int query) {
+	return queries[query].events;
+}
+
+/* How many events a query selected (any kind of sink) */
+long EventScan::getCount(int query) {
+	return queries[query].count;
+}
+
+/* The sum from an addSum query */
+double EventScan::getSum(int query) {
+	return queries[query].sum;
+}
@@ -0,0 +1,69 @@
+#include "../inc/EventStore.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Compact, column-wise storage for a run's events. See EventStore.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Start out empty */
+EventStore::EventStore() {
+	explicitRealtime = false;
+}
+
+/* Fill the columns from events. Returns false if they don't fit. */
+bool EventStore::pack(const std::vector<input_t>& events) {
+	this->clear();
+
+	/* make sure every channel and tag fits in its column, and check if
+	 * the realtimes can be rebuilt from the clock */
+	for(auto it = events.begin(); it < events.end(); it++) {
+		if((*it).ch < 0 || (*it).ch > UINT8_MAX || (*it).tag < 0 || (*it).tag > UINT16_MAX) {
+			return false;
+		}
+		if((*it).realtime != ((double)(*it).time) * CLKTONS) {
+			explicitRealtime = true;
+		}
+	}
+
+	ticks.reserve(events.size());
+	chs.reserve(events.size());
+	tags.reserve(events.size());
+	if(explicitRealtime) {
+		realtimes.reserve(events.size());
+	}
+	for(auto it = events.begin(); it < events.end(); it++) {
+		ticks.push_back((*it).time);
+		chs.push_back((*it).ch);
+		tags.push_back((*it).tag);
+		if(explicitRealtime) {
+			realtimes.push_back((*it).realtime);
+		}
+	}
+	return true;
+}
+
+/* Turn the columns back into a vector of input_t */
+void EventStore::unpack(std::vector<input_t>& out) const {
+	out.clear();
+	out.reserve(this->size());
+	long i;
+	for(i = 0; i < (long)this->size(); i++) {
+		out.push_back(this->get(i));
+	}
+}
+
+/* Drop all the events and give back the memory */
+void EventStore::clear() {
+	std::vector<uint64_t>().swap(ticks);
+	std::vector<uint8_t>().swap(chs);
+	std::vector<uint16_t>().swap(tags);
+	std::vector<double>().swap(realtimes);
+	explicitRealtime = false;
+}
+
+/* Bytes held by the columns */
+size_t EventStore::memoryUsage() const {
+	return ticks.capacity() * sizeof(uint64_t) + chs.capacity() * sizeof(uint8_t)
+		 + tags.capacity() * sizeof(uint16_t) + realtimes.capacity() * sizeof(double);
+}
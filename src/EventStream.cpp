@@ -0,0 +1,186 @@
+#include "../inc/EventStream.hpp"
+#include <algorithm>
+#include <functional>
+
+#define CLKTONS 0.0000000008
+
+/* never go below this many events per buffer, however small the budget */
+#define MINSTREAMEVENTS 1024
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Time-ordered, memory-bounded walk over a tree. See EventStream.hpp for how it works.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Set up the reader and split the budget between sorting and output */
+EventStream::EventStream(TTree* tree, bool recomputeRealtime, size_t budgetBytes) : reader(tree) {
+	this->recomputeRealtime = recomputeRealtime;
+	tickRealtime = true;
+	sorted = false;
+	memPos = 0;
+
+	/* half the budget holds a run while sorting, a quarter goes to the
+	 * merge buffers and a quarter to each chunk we hand out. */
+	size_t budgetEvents = budgetBytes / sizeof(input_t);
+	runEvents = std::max(budgetEvents / 2, (size_t)MINSTREAMEVENTS);
+	chunkEvents = std::max(budgetEvents / 4, (size_t)MINSTREAMEVENTS);
+}
+
+/* Close out the spilled runs. tmpfile() deletes them for us. */
+EventStream::~EventStream() {
+	for(auto it = runFiles.begin(); it < runFiles.end(); it++) {
+		fclose(*it);
+	}
+}
+
+/* Check that the tree had all the leaves we need */
+bool EventStream::isValid() {
+	return reader.isValid();
+}
+
+/* Read the tree into sorted runs, spilling to disk if it doesn't fit */
+void EventStream::sortRuns() {
+	std::vector<input_t> buffer;
+	buffer.reserve(runEvents);
+	long numRead = 0;
+	long n;
+
+	/* read a cluster at a time and cut a run whenever the buffer fills. The
+	 * reads stop where the buffer is full, so it never grows past runEvents. */
+	while(true) {
+		if(buffer.size() >= runEvents) {
+			this->spillRun(buffer);
+		}
+		n = reader.readBlock(buffer, runEvents - buffer.size());
+		if(n == 0) {
+			break;
+		}
+		numRead += n;
+	}
+	this->fixRealtime(buffer);
+	std::sort(buffer.begin(), buffer.end(), [](input_t x, input_t y)->bool{return (x.realtime < y.realtime);});
+
+	/* everything fit in memory, so there is nothing to merge */
+	if(runFiles.empty()) {
+		memRun.swap(buffer);
+	}
+	else if(!buffer.empty()) {
+		this->spillRun(buffer);
+	}
+	printf("Streaming %ld events in %lu sorted runs\n", numRead, runFiles.empty() ? 1 : runFiles.size());
+	sorted = true;
+	this->rewind();
+}
+
+/* Sort the buffer and write it out as one run */
+void EventStream::spillRun(std::vector<input_t>& buffer) {
+	this->fixRealtime(buffer);
+	std::sort(buffer.begin(), buffer.end(), [](input_t x, input_t y)->bool{return (x.realtime < y.realtime);});
+	FILE* run = tmpfile();
+	if(run == NULL || fwrite(buffer.data(), sizeof(input_t), buffer.size(), run) != buffer.size()) {
+		fprintf(stderr, "Error! Could not spill sorted run to disk. Stopping analysis\n");
+		exit(1);
+	}
+	runFiles.push_back(run);
+	runLengths.push_back(buffer.size());
+	buffer.clear();
+}
+
+/* Rebuild the realtimes of a run from the clock if we were asked to, and
+ * otherwise check whether they could have been */
+void EventStream::fixRealtime(std::vector<input_t>& buffer) {
+	for(auto it = buffer.begin(); it < buffer.end(); it++) {
+		if(recomputeRealtime) {
+			(*it).realtime = ((double)(*it).time) * CLKTONS;
+		}
+		else if((*it).realtime != ((double)(*it).time) * CLKTONS) {
+			tickRealtime = false;
+		}
+	}
+}
+
+/* Top up the read buffer of one run. Returns false when the run is done. */
+bool EventStream::refill(int run) {
+	if(runLeft[run] <= 0) {
+		return false;
+	}
+	size_t n = std::min((size_t)runLeft[run], runBufs[run].capacity());
+	runBufs[run].resize(n);
+	if(fread(runBufs[run].data(), sizeof(input_t), n, runFiles[run]) != n) {
+		fprintf(stderr, "Error! Short read from sorted run. Stopping analysis\n");
+		exit(1);
+	}
+	runLeft[run] -= n;
+	runPos[run] = 0;
+	return true;
+}
+
+/* Start over from the first event */
+void EventStream::rewind() {
+	if(!sorted) {
+		return;
+	}
+	memPos = 0;
+	if(runFiles.empty()) {
+		return;
+	}
+
+	/* split the merge quarter of the budget between the runs */
+	size_t bufEvents = std::max(chunkEvents / runFiles.size(), (size_t)MINSTREAMEVENTS);
+	runBufs.assign(runFiles.size(), std::vector<input_t>());
+	runPos.assign(runFiles.size(), 0);
+	runLeft.assign(runLengths.begin(), runLengths.end());
+	heap.clear();
+
+	/* prime each run and push its first event on the heap */
+	int i;
+	for(i = 0; i < (int)runFiles.size(); i++) {
+		fseek(runFiles[i], 0, SEEK_SET);
+		runBufs[i].reserve(bufEvents);
+		if(this->refill(i)) {
+			heap.push_back(std::make_pair(runBufs[i][0].realtime, i));
+		}
+	}
+	std::make_heap(heap.begin(), heap.end(), std::greater<std::pair<double, int> >());
+}
+
+/* Whether every realtime is just its ticks*CLKTONS. We only know once the
+ * tree has been read, so sort it now if we haven't. */
+bool EventStream::realtimeFromTicks() {
+	if(!sorted) {
+		this->sortRuns();
+	}
+	return tickRealtime;
+}
+
+/* Hand out the next chunk of time-ordered events */
+bool EventStream::next(std::vector<input_t>& chunk) {
+	chunk.clear();
+	if(!sorted) {
+		this->sortRuns();
+	}
+
+	/* a single run is just a slice of memory */
+	if(runFiles.empty()) {
+		size_t n = std::min(chunkEvents, memRun.size() - memPos);
+		chunk.assign(memRun.begin() + memPos, memRun.begin() + memPos + n);
+		memPos += n;
+		return !chunk.empty();
+	}
+
+	/* otherwise merge: take the earliest head and advance that run */
+	chunk.reserve(chunkEvents);
+	while(chunk.size() < chunkEvents && !heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<double, int> >());
+		int run = heap.back().second;
+		heap.pop_back();
+		chunk.push_back(runBufs[run][runPos[run]]);
+		runPos[run]++;
+		if(runPos[run] < runBufs[run].size() || this->refill(run)) {
+			heap.push_back(std::make_pair(runBufs[run][runPos[run]].realtime, run));
+			std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<double, int> >());
+		}
+	}
+	return !chunk.empty();
+}
@@ -0,0 +1,79 @@
+#include "../inc/EventView.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Read-only views of a run's events. See EventView.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* A view of nothing */
+EventView::EventView() {
+	events = NULL;
+	store = NULL;
+	index = NULL;
+	num = 0;
+	offset = 0.0;
+}
+
+/* The num events of events at index (all of them if index is NULL) */
+EventView::EventView(const std::vector<input_t>& events, const uint32_t* index, long num) : EventView() {
+	this->events = &events;
+	this->index = index;
+	this->num = num;
+}
+
+/* The num events of store at index (all of them if index is NULL) */
+EventView::EventView(const EventStore& store, const uint32_t* index, long num) : EventView() {
+	this->store = &store;
+	this->index = index;
+	this->num = num;
+}
+
+/* The events of events at an index we hold on to */
+EventView::EventView(const std::vector<input_t>& events, std::shared_ptr<const std::vector<uint32_t> > index) : EventView() {
+	this->events = &events;
+	this->index = index->data();
+	this->num = index->size();
+	ownedIndex = index;
+}
+
+/* The events of store at an index we hold on to */
+EventView::EventView(const EventStore& store, std::shared_ptr<const std::vector<uint32_t> > index) : EventView() {
+	this->store = &store;
+	this->index = index->data();
+	this->num = index->size();
+	ownedIndex = index;
+}
+
+/* All of a vector of events we hold on to */
+EventView::EventView(std::shared_ptr<const std::vector<input_t> > events) : EventView() {
+	this->events = events.get();
+	this->num = events->size();
+	ownedEvents = events;
+}
+
+/* The same events with their realtimes moved by dt */
+EventView EventView::shift(double dt) const {
+	EventView shifted = *this;
+	shifted.offset += dt;
+	return shifted;
+}
+
+/* Fill hist with the (shifted) realtime of every event */
+void EventView::fillHist(TH1D* hist) const {
+	long i;
+	for(i = 0; i < num; i++) {
+		hist->Fill(this->getRealtime(i));
+	}
+}
+
+/* Copy the (shifted) events out */
+std::vector<input_t> EventView::toVector() const {
+	std::vector<input_t> out;
+	out.reserve(num);
+	long i;
+	for(i = 0; i < num; i++) {
+		out.push_back((*this)[i]);
+	}
+	return out;
+}
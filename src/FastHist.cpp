@@ -0,0 +1,91 @@
+#include "../inc/FastHist.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Fixed-bin histograms for the analysis loops. See FastHist.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* An empty, unnamed histogram. It has no range, so it can't be filled. */
+FastHist::FastHist() {
+	numBins = 1;
+	low = 0.0;
+	high = 0.0;
+	entries = 0.0;
+	sumw = 0.0;
+	sumw2 = 0.0;
+	sumwx = 0.0;
+	sumwx2 = 0.0;
+}
+
+/* Same arguments as a TH1D. Nothing is allocated until the first fill. 
+ * Like a TH1D, we always have at least one bin. We don't guess a range
+ * like TH1D does, so a histogram with high <= low is refused and won't
+ * fill. */
+FastHist::FastHist(const char* name, const char* title, int numBins, double low, double high) {
+	if(!(high > low)) {
+		fprintf(stderr, "Error! Histogram %s needs high > low (got %f to %f)! It will stay empty.\n", name, low, high);
+	}
+	this->name = name;
+	this->title = title;
+	this->numBins = numBins < 1 ? 1 : numBins;
+	this->low = low;
+	this->high = high;
+	entries = 0.0;
+	sumw = 0.0;
+	sumw2 = 0.0;
+	sumwx = 0.0;
+	sumwx2 = 0.0;
+}
+
+/* Add in another histogram with the same binning (e.g. a thread's copy) */
+void FastHist::add(const FastHist& other) {
+	if(other.numBins != numBins || other.low != low || other.high != high) {
+		fprintf(stderr, "Error! Can't add histogram %s to %s with different binning\n", other.name.c_str(), name.c_str());
+		return;
+	}
+	if(!other.bins.empty()) {
+		if(bins.empty()) {
+			bins.assign(numBins + 2, 0.0);
+		}
+		long i;
+		for(i = 0; i < (long)bins.size(); i++) {
+			bins[i] += other.bins[i];
+		}
+	}
+	entries += other.entries;
+	sumw += other.sumw;
+	sumw2 += other.sumw2;
+	sumwx += other.sumwx;
+	sumwx2 += other.sumwx2;
+}
+
+/* Empty the histogram and give back the bins */
+void FastHist::reset() {
+	std::vector<double>().swap(bins);
+	entries = 0.0;
+	sumw = 0.0;
+	sumw2 = 0.0;
+	sumwx = 0.0;
+	sumwx2 = 0.0;
+}
+
+/* Build the equivalent TH1D. It isn't attached to any directory, so the
+ * caller owns it outright. */
+TH1D FastHist::toTH1D() const {
+	TH1D hist(name.c_str(), title.c_str(), numBins, low, high);
+	hist.SetDirectory(0);
+	if(!bins.empty()) {
+		int i;
+		for(i = 0; i < (int)bins.size(); i++) {
+			hist.SetBinContent(i, bins[i]);
+			if(hist.GetSumw2N() > 0) {
+				hist.SetBinError(i, sqrt(bins[i]));
+			}
+		}
+	}
+	double stats[4] = {sumw, sumw2, sumwx, sumwx2};
+	hist.PutStats(stats);
+	hist.SetEntries(entries);
+	return hist;
+}
@@ -1,6 +1,7 @@
 #include "../inc/Functions.hpp"
 #include "TCanvas.h"
 #include "TGraph.h"
+#include <atomic>
 
 /* define constants we need for later */
 #define NANOSECOND .000000001
@@ -9,6 +10,9 @@
 #define synthbkg_50_500_2 0.0
 #define TAUN 877.7
 
+/* numbers the fits so their names never clash */
+static std::atomic<long> fitNumber(0);
+
 /*----------------------------------------------------------------------------
 	Author: Nathan B. Callahan (?)
 	Editor: Frank M. Gonzalez
@@ -87,7 +91,7 @@ measurement expWeightMon(TH1D* mon, double end) {
 }
 
 /* another weight monitor, but this time in vector form */
-measurement expWeightMonVect(std::vector<input_t> &cts) {
+measurement expWeightMonVect(const EventView &cts) {
 	double invTau = 1.0/70.0;
 	measurement weight = {0.0, 0.0};
 	weight.val = std::accumulate(cts.begin(), cts.end(), 0.0,
@@ -114,15 +118,15 @@ void protheroePeriodicTest(Run* run) {
 	int maxIB = 0;
 	for(i = 0; i < 1000; i++) {
 		std::vector<input_t> ctsA = run->getCounts(
-			[](input_t x)->input_t{return x;},
-			[i](input_t x)->bool{return x.ch == 1 && x.realtime > (600.0+i) && x.realtime < (600.0+i+1.0);}
+			CHMASK(1), nextafter(600.0+i, INFINITY), 600.0+i+1.0,
+			[](input_t x)->input_t{return x;}
 		);
 		std::vector<double> phiA;
 		std::transform(ctsA.begin(), ctsA.end(), back_inserter(phiA), [freq](input_t x)->double{return fmod(x.realtime, 1.0/freq)/(1.0/freq);});
 
 		std::vector<input_t> ctsB = run->getCounts(
-			[](input_t x)->input_t{return x;},
-			[i](input_t x)->bool{return x.ch == 2 && x.realtime > (600.0+i) && x.realtime < (600.0+i+1.0);}
+			CHMASK(2), nextafter(600.0+i, INFINITY), 600.0+i+1.0,
+			[](input_t x)->input_t{return x;}
 		);
 		std::vector<double> phiB;
 		std::transform(ctsB.begin(), ctsB.end(), back_inserter(phiB), [freq](input_t x)->double{return fmod(x.realtime, 1.0/freq)/(1.0/freq);});
@@ -159,12 +163,12 @@ void protheroePeriodicTest(Run* run) {
 void rayleighPeriodicTest(Run* run) {
 	double freq = 20003.75;
 	std::vector<input_t> ctsA = run->getCounts(
-		[](input_t x)->input_t{return x;},
-		[](input_t x)->bool{return x.ch == 1 && x.realtime > 200.0 && x.realtime < 1200.0;}
+		CHMASK(1), nextafter(200.0, INFINITY), 1200.0,
+		[](input_t x)->input_t{return x;}
 	);
 	std::vector<input_t> ctsB = run->getCounts(
-		[](input_t x)->input_t{return x;},
-		[](input_t x)->bool{return x.ch == 2 && x.realtime > 200.0 && x.realtime < 1200.0;}
+		CHMASK(2), nextafter(200.0, INFINITY), 1200.0,
+		[](input_t x)->input_t{return x;}
 	);
 	double z2_20_A = 0.0;
 	double z2_20_B = 0.0;
@@ -208,7 +212,7 @@ void fitFill(Run* run) {
 	printf("Using constant fillEnd!\n");
 	double fillEnd = 150.0;
 	
-	TH1D sp = run->getHist([](input_t x)->double{return x.realtime;}, [fillEnd](input_t x)->bool{return (x.ch == 5 && x.realtime < fillEnd);});
+	TH1D sp = run->getHist(CHMASK(5), [](input_t x)->double{return x.realtime;}, [fillEnd](input_t x)->bool{return (x.ch == 5 && x.realtime < fillEnd);});
 	
 	//~ std::vector<input_t> spCts = run->getCounts(
 		//~ [fillEnd](input_t x)->input_t{return x;},
@@ -232,8 +236,12 @@ void fitFill(Run* run) {
 		func.addOffset(*it);
 	}
 
+	/* ROOT keeps functions in a global list by name, so each fit gets a
+	 * name of its own in case other runs are being fit at the same time */
 	int i;
-	TF1* fit = new TF1("fit", func, 0.0, 150.0, beamHits.size());
+	char fitName[64];
+	snprintf(fitName, sizeof(fitName), "fit%05d_%ld", run->getRunNo(), fitNumber++);
+	TF1* fit = new TF1(fitName, func, 0.0, 150.0, beamHits.size());
 	for(i = 0; i < beamHits.size(); i++) {
 		fit->SetParameter(i, 800);
 		fit->SetParLimits(i, 0.0, 10000);
@@ -335,11 +343,16 @@ std::vector<double> dagDips(Run* run) {
 }
 
 double getDeadTimeCounts(Run* run, double start, double end) {
-	int coincType = run->getCoincMode();
-	double deadTimeCounts = 0.0;
 	std::vector<input_t> cts = run->getCoincCounts(
 			[](input_t x)->input_t{return x;},
 			[start, end](input_t x)->bool{return (x.realtime > start && x.realtime < end);});
+	return getDeadTimeCounts(run, start, end, cts);
+}
+
+/* Same, but with the coincidences between start and end already in hand */
+double getDeadTimeCounts(Run* run, double start, double end, const std::vector<input_t>& cts) {
+	int coincType = run->getCoincMode();
+	double deadTimeCounts = 0.0;
 	if(cts.size() < 1) {
 		return 0.0;
 	}
@@ -391,8 +404,8 @@ void bkgRunBkg(Run* run) {
 //			[stepTime, stepTimePrev](input_t x)->bool{return (x.realtime > stepTimePrev && x.realtime < stepTime);}
 //		);
 		std::vector<input_t> dagCts = run->getCounts(
-			[](input_t x)->input_t{return x;},
-			[stepTime, stepTimePrev](input_t x)->bool{return ((x.ch == 1 || x.ch == 2) && x.realtime > stepTimePrev + 10.0 && x.realtime < stepTime - 10.0);}
+			CHMASK(1) | CHMASK(2), nextafter(stepTimePrev + 10.0, INFINITY), stepTime - 10.0,
+			[](input_t x)->input_t{return x;}
 		);
 		auto it = dagCts.begin();
 		unsigned long numCts = 1;
@@ -426,18 +439,12 @@ void normNByDip(Run* run) {
 		return;
 	}
 	double fillEnd = beamHits.back();
-	std::vector<input_t> spCts = run->getCounts(
-		[fillEnd](input_t x)->input_t{input_t y = x; y.realtime -= fillEnd; return y;},
-		[fillEnd](input_t x)->bool{return x.ch == 5 && x.realtime < fillEnd;}
-	);
+	EventView spCts = run->getCountsView(CHMASK(5), -INFINITY, fillEnd).shift(-fillEnd);
 	//~ std::vector<input_t> oldCts = run->getCounts(
 		//~ [fillEnd](input_t x)->input_t{input_t y = x; y.realtime -= fillEnd; return y;},
 		//~ [fillEnd](input_t x)->bool{return x.ch == 3 && x.realtime < fillEnd;}
 	//~ );
-	std::vector<input_t> bareCts = run->getCounts(
-		[fillEnd](input_t x)->input_t{input_t y = x; y.realtime -= fillEnd; return y;},
-		[fillEnd](input_t x)->bool{return x.ch == 4 && x.realtime < fillEnd;}
-	);
+	EventView bareCts = run->getCountsView(CHMASK(4), -INFINITY, fillEnd).shift(-fillEnd);
 	measurement weightSP = expWeightMonVect(spCts);
 	//~ measurement weightOld = expWeightMonVect(oldCts);
 	measurement weightBare = expWeightMonVect(bareCts);
@@ -469,17 +476,26 @@ void normNByDip(Run* run) {
 	double endTime;
 	//measurement num;
 	
+	/* pull every step's coincidences out in one pass */
+	EventScan steps;
 	for(stepIt = stepItStart; stepIt < stepItStop; stepIt++) {
 		startTime = *(stepIt-1);
 		endTime = *(stepIt);
-		std::vector<input_t> dagCts = run->getCoincCounts(
-			[](input_t x)->input_t{return x;},
-			[startTime, endTime](input_t x)->bool{return (x.realtime > startTime && x.realtime < endTime);}
+		steps.addVector(
+			[startTime, endTime](input_t x)->bool{return (x.realtime > startTime && x.realtime < endTime);},
+			[](input_t x)->input_t{return x;}
 		);
+	}
+	run->scanCoincCounts(steps);
+	
+	for(stepIt = stepItStart; stepIt < stepItStop; stepIt++) {
+		startTime = *(stepIt-1);
+		endTime = *(stepIt);
+		const std::vector<input_t>& dagCts = steps.getEvents(stepIt - stepItStart);
 		double stepMean = dagCts.size() > 0 ?
 			std::accumulate(dagCts.begin(), dagCts.end(), 0.0, [](double m, input_t x)->double{return m + x.realtime;}) / (double)dagCts.size()
 			: 0.0;
-		double deadTimeCounts = getDeadTimeCounts(run, startTime, endTime);
+		double deadTimeCounts = getDeadTimeCounts(run, startTime, endTime, dagCts);
 		//if(dagCts.size() > 0) {
 			//num = {(int)dagCts.size()+deadTimeCounts-bkgMov50ns1000ns6pe*(dagCts.back().realtime-dagCts.front().realtime), sqrt(dagCts.size())};
 		printf("Data - %d,%f,%f,%f,%lu,%f,%f,%f,%f,%f,%f\n",
@@ -525,18 +541,12 @@ void normNByDipSing(Run* run) {
 		return;
 	}
 	double fillEnd = beamHits.back();
-	std::vector<input_t> spCts = run->getCounts(
-		[fillEnd](input_t x)->input_t{input_t y = x; y.realtime -= fillEnd; return y;},
-		[fillEnd](input_t x)->bool{return x.ch == 5 && x.realtime < fillEnd;}
-	);
+	EventView spCts = run->getCountsView(CHMASK(5), -INFINITY, fillEnd).shift(-fillEnd);
 	//~ std::vector<input_t> oldCts = run->getCounts(
 		//~ [fillEnd](input_t x)->input_t{input_t y = x; y.realtime -= fillEnd; return y;},
 		//~ [fillEnd](input_t x)->bool{return x.ch == 3 && x.realtime < fillEnd;}
 	//~ );
-	std::vector<input_t> bareCts = run->getCounts(
-		[fillEnd](input_t x)->input_t{input_t y = x; y.realtime -= fillEnd; return y;},
-		[fillEnd](input_t x)->bool{return x.ch == 4 && x.realtime < fillEnd;}
-	);
+	EventView bareCts = run->getCountsView(CHMASK(4), -INFINITY, fillEnd).shift(-fillEnd);
 	measurement weightSP = expWeightMonVect(spCts);
 	//~ measurement weightOld = expWeightMonVect(oldCts);
 	measurement weightBare = expWeightMonVect(bareCts);
@@ -551,39 +561,34 @@ void normNByDipSing(Run* run) {
 	double startTime;
 	double endTime = dagSteps.front();
 	//measurement num;
-	std::vector<input_t> bkgDagCts = run->getCounts(
-		[](input_t x)->input_t{return x;},
-		[endTime](input_t x)->bool{return ((x.ch == 1 || x.ch == 2) && x.realtime > (endTime - 500.0) && x.realtime < endTime);}
-	);
+	long numBkgDag = run->getNumCounts(CHMASK(1) | CHMASK(2), nextafter(endTime - 500.0, INFINITY), endTime);
 
-	double bkgRate = bkgDagCts.size() / (500.0);
+	double bkgRate = numBkgDag / (500.0);
 	
 	for(stepIt = stepItStart; stepIt < stepItStop; stepIt++) {
 		startTime = *(stepIt-1);
 		endTime = *(stepIt);
-		std::vector<input_t> dagCts = run->getCounts(
-			[](input_t x)->input_t{return x;},
-			[startTime, endTime](input_t x)->bool{return ((x.ch == 1 || x.ch == 2) && x.realtime > startTime && x.realtime < endTime);}
-		);
+		EventView dagCts = run->getCountsView(CHMASK(1) | CHMASK(2), nextafter(startTime, INFINITY), endTime);
 		
 		double stepMean = dagCts.size() > 0 ?
 			std::accumulate(dagCts.begin(), dagCts.end(), 0.0, [](double m, input_t x)->double{return m + x.realtime;}) / (double)dagCts.size()
 			: 0.0;
 		
 		//Deadtime correction
-		double time = floor(dagCts.front().realtime);
+		double time = dagCts.empty() ? 0.0 : floor(dagCts.getRealtime(0));
 		double counts = 0.0;
 		double corr = 0.0;
-		for(auto cIt = dagCts.begin(); cIt < dagCts.end(); cIt++) {
-			if(floor(cIt->realtime) != time) {
+		long i;
+		for(i = 0; i < dagCts.size(); i++) {
+			if(floor(dagCts.getRealtime(i)) != time) {
 				corr += (counts/(1.0-counts*10*NANOSECOND) - counts);
 				counts = 0.0;
-				time = floor(cIt->realtime);
+				time = floor(dagCts.getRealtime(i));
 			}
 			counts += 1.0;
 		}
 
-		printf("Data - %d,%f,%f,%f,%lu,%f,%f,%f,%f,%f,%f\n",
+		printf("Data - %d,%f,%f,%f,%ld,%f,%f,%f,%f,%f,%f\n",
 			   run->getRunNo(), startTime, endTime, stepMean,
 			   dagCts.size(), corr, bkgRate,
 			   weightSP.val, weightSP.err, weightBare.val, weightBare.err);
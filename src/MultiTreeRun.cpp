@@ -0,0 +1,124 @@
+#include "../inc/MultiTreeRun.hpp"
+#include "../inc/TreeReader.hpp"
+#include "../inc/EventCache.hpp"
+#include "TList.h"
+#include "TROOT.h"
+#include <thread>
+#include <chrono>
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Loads all the MCS trees of a run file in parallel. See MultiTreeRun.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Read one tree into events on its own thread. ROOT won't let two threads
+ * into one TFile, so a thread not given the shared file opens its own copy
+ * and reads from that, with its own read cache. */
+static void readTreeThread(const char* fileName, const char* treeName, TFile* sharedFile, std::vector<input_t>* events) {
+
+	/* a warm cache never touches the file at all */
+	if(EventCache::load(fileName, treeName, *events)) {
+		return;
+	}
+	auto startTime = std::chrono::steady_clock::now();
+
+	TFile* file = sharedFile;
+	if(file == NULL) {
+		file = new TFile(fileName, "read");
+	}
+	TTree* tree = NULL;
+	TList* list = file->IsZombie() ? NULL : file->GetListOfKeys();
+	if(list != NULL && list->Contains(treeName)) {
+		file->GetObject(treeName, tree);
+	}
+	if(tree == NULL) {
+		if(file != sharedFile) {
+			delete file;
+		}
+		return;
+	}
+
+	/* read the tree a cluster at a time */
+	TreeReader reader(tree);
+	long numRead = 0;
+	if(reader.isValid()) {
+		events->reserve(reader.getEntries());
+		numRead = reader.readAll(*events);
+	}
+	if(file != sharedFile) {
+		delete file;
+	}
+
+	/* sort the data, assuming we have data */
+	if(!events->empty()) {
+		std::sort(events->begin(), events->end(), [](input_t x, input_t y)->bool{return (x.realtime < y.realtime);});
+		EventCache::save(fileName, treeName, *events);
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	printf("Read %ld events from %s:%s in %.2f s (%.3e events/s)\n",
+		   numRead, fileName, treeName, elapsed, elapsed > 0.0 ? numRead / elapsed : 0.0);
+}
+
+/* Open the run file once and load every tree in trees on its own thread */
+MultiTreeRun::MultiTreeRun(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode, std::string runBody, std::vector<std::string> trees) {
+
+	/* build the file name the same way Run does */
+	snprintf(fileName, sizeof(fileName), runBody.c_str(), runNo);
+	treeNames = trees;
+
+	/* we're about to use ROOT from several threads */
+	ROOT::EnableThreadSafety();
+	dataFile = new TFile(fileName, "read");
+
+	/* read all the trees at once. The first tree is read through our file,
+	 * the others through their own. */
+	std::vector<std::vector<input_t> > events(trees.size());
+	std::vector<std::thread> threads;
+	int i;
+	for(i = 0; i < (int)trees.size(); i++) {
+		threads.push_back(std::thread(readTreeThread, fileName, treeNames[i].c_str(), i == 0 ? dataFile : (TFile*)NULL, &events[i]));
+	}
+	for(auto it = threads.begin(); it < threads.end(); it++) {
+		(*it).join();
+	}
+
+	/* hand each tree's events to a Run sharing our file */
+	for(i = 0; i < (int)trees.size(); i++) {
+		runs.push_back(new Run(coincWindow, peSumWindow, peSum, runNo, coincMode, dataFile, treeNames[i].c_str(), events[i]));
+	}
+}
+
+/* Clean up the Runs before the file they share */
+MultiTreeRun::~MultiTreeRun() {
+	for(auto it = runs.begin(); it < runs.end(); it++) {
+		delete *it;
+	}
+	delete dataFile;
+}
+
+/* Check to make sure the file actually loads normally */
+bool MultiTreeRun::exists() {
+	return(!dataFile->IsZombie());
+}
+
+/* Number of trees (and Runs) we loaded */
+int MultiTreeRun::getNumRuns() {
+	return runs.size();
+}
+
+/* The Run for the i-th tree we were given */
+Run* MultiTreeRun::getRun(int i) {
+	return runs.at(i);
+}
+
+/* The Run for a tree by name, or NULL if we didn't load it */
+Run* MultiTreeRun::getRun(const char* tree) {
+	int i;
+	for(i = 0; i < (int)treeNames.size(); i++) {
+		if(treeNames[i] == tree) {
+			return runs[i];
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,90 @@
+#include "../inc/Run.hpp"
+#include "../inc/EventStore.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	These functions keep a per-channel index of a loaded run, so queries on one channel (the
+	monitors, the daggers) only touch that channel's events instead of the whole run.
+
+	The first time it's needed we walk the run once and append each event's index to the list for
+	its channel. Since the run is sorted, each list is in time order too. Masks with more than one
+	channel get their lists merged once and kept, so e.g. the coincidence finder reuses the merged
+	ch1/ch2 list every time it runs.
+
+	Since the lists are in time order, a time window [t0, t1) on them is found by binary search
+	(findTimeRange) rather than by checking every event.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Split the loaded run into per-channel index lists */
+void Run::buildChannelIndex() {
+	chIndex.assign(32, std::vector<uint32_t>());
+	maskIndex.clear();
+
+	long size = store != NULL ? store->size() : data.size();
+	long i;
+	int ch;
+	for(i = 0; i < size; i++) {
+		ch = store != NULL ? store->getCh(i) : data[i].ch;
+		if(ch >= 0 && ch < 32) {
+			chIndex[ch].push_back(i);
+		}
+	}
+}
+
+/* The sorted indices of all events on the channels in chMask. The run
+ * must already be loaded. */
+const std::vector<uint32_t>& Run::getChannelIndex(uint32_t chMask) {
+	if(chIndex.empty()) {
+		this->buildChannelIndex();
+	}
+
+	/* a single channel is just its own list */
+	if(chMask != 0 && (chMask & (chMask - 1)) == 0) {
+		int ch = 0;
+		while(!(chMask & CHMASK(ch))) {
+			ch++;
+		}
+		return chIndex[ch];
+	}
+
+	/* otherwise merge the channels' lists, once */
+	auto found = maskIndex.find(chMask);
+	if(found != maskIndex.end()) {
+		return found->second;
+	}
+	std::vector<uint32_t>& merged = maskIndex[chMask];
+	std::vector<uint32_t> scratch;
+	int ch;
+	for(ch = 0; ch < 32; ch++) {
+		if(!(chMask & CHMASK(ch)) || chIndex[ch].empty()) {
+			continue;
+		}
+		scratch.clear();
+		scratch.reserve(merged.size() + chIndex[ch].size());
+		std::merge(merged.begin(), merged.end(), chIndex[ch].begin(), chIndex[ch].end(), std::back_inserter(scratch));
+		merged.swap(scratch);
+	}
+	return merged;
+}
+
+/* Binary search for the events in [t0, t1) on either storage */
+template <class Events>
+static void timeBounds(const Events& evts, const std::vector<uint32_t>& index, double t0, double t1, long& first, long& last) {
+	auto before = [&evts](uint32_t i, double t)->bool{return eventRealtime(evts, i) < t;};
+	auto lo = std::lower_bound(index.begin(), index.end(), t0, before);
+	auto hi = t1 > t0 ? std::lower_bound(lo, index.end(), t1, before) : lo;
+	first = lo - index.begin();
+	last = hi - index.begin();
+}
+
+/* Find the positions [first, last) in index of the events with realtime
+ * in [t0, t1). The run must already be loaded. */
+void Run::findTimeRange(const std::vector<uint32_t>& index, double t0, double t1, long& first, long& last) {
+	if(store != NULL) {
+		timeBounds(*store, index, t0, t1, first, last);
+	}
+	else {
+		timeBounds(data, index, t0, t1, first, last);
+	}
+}
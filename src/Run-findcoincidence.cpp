@@ -1,6 +1,15 @@
 #include "../inc/Run.hpp"
+#include "../inc/EventStore.hpp"
+#include "../inc/CoincSweep.hpp"
+#include "../inc/CoincCache.hpp"
+#include <thread>
+#include <atomic>
 #define NANOSECOND .000000001
 
+/* how many chunks each thread gets on average, so that a few busy chunks
+ * don't leave the other threads waiting */
+#define CHUNKSPERTHREAD 8
+
 /*	------------------------------------------------------------------------------------------------
 	Author: Nathan B. Callahan
 	Editor: Frank M. Gonzalez
@@ -23,239 +32,491 @@
 	
 	If there is only one gamma in the window and it met the timing and energy cuts, then the event
 	is placed into the coincidence vector.
+	
+	Only dagger (ch1/ch2) events are counted and the windows are set by time alone, so on a loaded
+	run we search just the dagger channel index and skip the monitors and tag events entirely.
+	A stream is cut down to its daggers the same way before it is searched.
+
+	Since every event searched is a dagger, a start event is decided by the first later event on
+	the other channel (nextOpposite) and the end of the tail after it, and the PE sum is just the
+	number of events from the start to the end of the tail. Both positions only move forwards as
+	the start does, so each is kept as a pointer that picks up from where the last start event
+	left it, and the search is linear in the number of daggers. The hits are only gathered for
+	the neutrons. Times are compared as integer clock ticks when every realtime comes from the
+	clock (tickClock), so the windows hold a fixed number of ticks and the comparisons are exact,
+	and as realtimes otherwise (realtimeClock).
+
+	The photon hits of each coincidence are kept as positions in the run's events, one flat array
+	per PMT (see coincHits), rather than as copies.
+	
+	With more than one coincidence thread (setCoincThreads), the daggers are cut into chunks at
+	quiet gaps longer than both windows. No search started before such a gap can reach past it,
+	and a deadtime skip can't jump over it, so every chunk is searched on its own exactly as the
+	serial loop would have searched it. The chunks go to a pool of threads and their results are
+	merged back in time order, so the coincidences, hits and phs come out the same either way.
 	------------------------------------------------------------------------------------------------	*/
 
-/* Coincidence timer -- subset of run */
-void Run::findcoincidenceFixed() {
+/* Add one coincidence's hits (positions in evts) to a PMT's coincHits. On a
+ * loaded run evts is a subset of the run's events, so we keep the positions
+ * in the run itself. */
+template <class Events>
+static void keepHits(const EventSubset<Events>& evts, const std::vector<long>& hits, coincHits& pmtHits, std::vector<input_t>& copied) {
+	if(pmtHits.offsets.empty()) {
+		pmtHits.offsets.push_back(0);
+	}
+	size_t j;
+	for(j = 0; j < hits.size(); j++) {
+		pmtHits.index.push_back(evts.index[hits[j]]);
+	}
+	pmtHits.offsets.push_back(pmtHits.index.size());
+}
+
+/* A streamed window is gone once we move on, so its hits are copied out 
+ * and we keep positions in the copies */
+static void keepHits(const std::vector<input_t>& evts, const std::vector<long>& hits, coincHits& pmtHits, std::vector<input_t>& copied) {
+	if(pmtHits.offsets.empty()) {
+		pmtHits.offsets.push_back(0);
+	}
+	size_t j;
+	for(j = 0; j < hits.size(); j++) {
+		pmtHits.index.push_back(copied.size());
+		copied.push_back(evts[hits[j]]);
+	}
+	pmtHits.offsets.push_back(pmtHits.index.size());
+}
+
+/* The first event after start on the other dagger channel. next[ch] holds
+ * the first event on ch after an earlier start event, so it is still right
+ * if it's past this one, and it only ever moves forwards. */
+template <class Events>
+static long nextOpposite(const Events& evts, long start, long end, long* next) {
+	int other = eventCh(evts, start) == 1 ? 2 : 1;
+	long& opp = next[other];
+	if(opp <= start) {
+		opp = start+1;
+	}
+	while(opp < end && eventCh(evts, opp) != other) {
+		opp++;
+	}
+	return opp;
+}
+
+/* Keep a neutron found at start, with every dagger from it up to the end of
+ * its tail as its photon hits */
+template <class Events>
+static void keepNeutron(const Events& evts, long start, long tailEnd, std::vector<long>& pmtAHits, std::vector<long>& pmtBHits, coincResults& found) {
+	pmtAHits.clear();
+	pmtBHits.clear();
+	long k;
+	for(k = start; k < tailEnd; k++) {
+		if(eventCh(evts, k) == 1) {
+			pmtAHits.push_back(k);
+		}
+		else {
+			pmtBHits.push_back(k);
+		}
+	}
+	found.coinc.push_back(eventAt(evts, start));
+	keepHits(evts, pmtAHits, found.pmtAHits, found.copiedHits);
+	keepHits(evts, pmtBHits, found.pmtBHits, found.copiedHits);
+	found.phsA.fill((int)pmtAHits.size());
+	found.phsB.fill((int)pmtBHits.size());
+}
+
+/* Add more hits onto the end of hits, moving their positions up by shift */
+static void appendHits(coincHits& hits, const coincHits& more, uint32_t shift) {
+	if(more.empty()) {
+		return;
+	}
+	if(hits.offsets.empty()) {
+		hits.offsets.push_back(0);
+	}
+	uint32_t start = hits.index.size();
+	size_t j;
+	for(j = 0; j < more.index.size(); j++) {
+		hits.index.push_back(more.index[j] + shift);
+	}
+	for(j = 1; j < more.offsets.size(); j++) {
+		hits.offsets.push_back(start + more.offsets[j]);
+	}
+}
+
+/* Nothing found yet, with the phs binned like ours */
+coincResults Run::newCoincResults() {
+	coincResults found;
+	found.phsA = phsA;
+	found.phsA.reset();
+	found.phsB = phsB;
+	found.phsB.reset();
+	return found;
+}
+
+/* Add what a search found after everything we already have */
+void Run::mergeCoinc(const coincResults& found) {
+	coinc.insert(coinc.end(), found.coinc.begin(), found.coinc.end());
 	
-	/* check the data table and load it into ROOT tree */
-	if(data.empty()) {
-		this->readDataRoot();
+	/* hits copied out of a stream point into found's copies, which go on
+	 * the end of ours */
+	uint32_t shift = found.copiedHits.empty() ? 0 : copiedHits.size();
+	copiedHits.insert(copiedHits.end(), found.copiedHits.begin(), found.copiedHits.end());
+	appendHits(pmtACoincHits, found.pmtAHits, shift);
+	appendHits(pmtBCoincHits, found.pmtBHits, shift);
+	phsA.add(found.phsA);
+	phsB.add(found.phsB);
+}
+
+/* Pick up the results of an earlier search from the coincidence cache.
+ * Hits are positions in our events, which get loaded when they're needed.
+ * A streamed run keeps copies of its hits, so it has a cache of its own. */
+bool Run::loadCoincCache() {
+	bool streamed = memoryBudget > 0 && data.empty() && store == NULL;
+	coincCacheKey key = {fileName, sourceTree.c_str(), runNo, coincWindow, peSumWindow, peSum, coincMode, streamed};
+	coincResults found = this->newCoincResults();
+	if(!CoincCache::load(key, found)) {
+		return false;
 	}
-	if(data.empty()) {
+	this->mergeCoinc(found);
+	return true;
+}
+
+/* Save the results of a search we just did to the coincidence cache */
+void Run::saveCoincCache() {
+	if(!CoincCache::isEnabled()) {
 		return;
 	}
+	bool streamed = memoryBudget > 0 && data.empty() && store == NULL;
+	coincCacheKey key = {fileName, sourceTree.c_str(), runNo, coincWindow, peSumWindow, peSum, coincMode, streamed};
+	coincResults found;
+	found.coinc = coinc;
+	found.pmtAHits = pmtACoincHits;
+	found.pmtBHits = pmtBCoincHits;
+	found.copiedHits = copiedHits;
+	CoincCache::save(key, found);
+}
 
-	/* initialize iterators and variables */
-	int i;
-	int cur = 0;
-	int tailIt = 0;
-	int waveIt = 0;
+/* Search the daggers of a loaded run, comparing clock ticks if we can */
+template <class Events>
+void Run::findcoincidenceDaggers(const Events& evts, bool moving) {
+	if(realtimeFromTicks(evts)) {
+		this->findcoincidenceChunks<tickClock>(evts, moving);
+	}
+	else {
+		this->findcoincidenceChunks<realtimeClock>(evts, moving);
+	}
+}
+
+/* Search the daggers of a loaded run, in chunks on several threads if we
+ * have them. Chunks are cut at gaps no window can cross. */
+template <class Clock, class Events>
+void Run::findcoincidenceChunks(const Events& evts, bool moving) {
+	long size = evts.size();
+	int numThreads = threadCoincThreads > 0 ? threadCoincThreads : coincThreads;
+	if(numThreads <= 0) {
+		numThreads = (int)std::thread::hardware_concurrency();
+	}
 	
-	/* initialize variables for our pmt hits*/
-	int ch1PESum;
-	int ch2PESum;
-	std::vector<input_t> pmtAHits;
-	std::vector<input_t> pmtBHits;
-	std::vector<long> coincIndices;
-
-	/* look at each entry of our data vector. */
-	for(i = 0; i < data.size(); i++) {
-		
-		/* clear previous buffers */
-		ch1PESum = 0;
-		ch2PESum = 0;
-		pmtAHits.clear();
-		pmtBHits.clear();
-
-		/* for coincidence measurement, we only want dagger hits */
-		if(data.at(i).ch != 1 && data.at(i).ch != 2) { continue; }
-		
-		/* load info into our data hit vectors */
-		if(data.at(i).ch == 1) {
-			ch1PESum += 1;
-			pmtAHits.push_back(data.at(i));
-		}
-		if(data.at(i).ch == 2) {
-			ch2PESum += 1;
-			pmtBHits.push_back(data.at(i));
+	/* cut about CHUNKSPERTHREAD chunks per thread, each at the first gap
+	 * after it reaches its share of the events */
+	std::vector<long> cuts(1, 0);
+	if(numThreads > 1) {
+		typename Clock::span gap = Clock::window(std::max(coincWindow, peSumWindow)*NANOSECOND);
+		long share = size / ((long)numThreads * CHUNKSPERTHREAD) + 1;
+		long i = share;
+		while(i < size) {
+			if(Clock::at(evts, i) - Clock::at(evts, i-1) > gap) {
+				cuts.push_back(i);
+				i += share;
+			}
+			else {
+				i++;
+			}
 		}
-		
-		/* once we load our dataset, search forwards to find coincidences */
-		for(cur = i+1; cur < data.size(); cur++) { 
-			
-			/* check the times of our two paired events. If the times are
-			 * not about the same, break. We don't have a coincidence! */
-			if(data.at(cur).realtime - data.at(i).realtime > coincWindow*NANOSECOND) {
-				break; 
+	}
+	cuts.push_back(size);
+	
+	/* each thread takes the next chunk until there are none left */
+	long numChunks = cuts.size() - 1;
+	std::vector<coincResults> found(numChunks, this->newCoincResults());
+	std::atomic<long> next(0);
+	auto searchChunks = [&]() {
+		long c;
+		while((c = next++) < numChunks) {
+			if(moving) {
+				this->findcoincidenceMoving<Clock>(evts, cuts[c], cuts[c+1], true, found[c]);
 			}
-			/* we only want coincidences in the dagger */
-			if(data.at(cur).ch != 1 && data.at(cur).ch != 2) { continue; }
-			/* count our coincidences in the same channel i */ 
-			if(data.at(cur).ch == data.at(i).ch) {
-				if(data.at(cur).ch == 1) {
-					ch1PESum += 1;
-					pmtAHits.push_back(data.at(cur));
-				}
-				if(data.at(cur).ch == 2) {
-					ch2PESum += 1;
-					pmtBHits.push_back(data.at(cur));
-				}
+			else {
+				this->findcoincidenceFixed<Clock>(evts, cuts[c], cuts[c+1], true, found[c]);
 			}
-			/* count our coincidences in different channels */
-			if(data.at(cur).ch != data.at(i).ch) {				
-				if(data.at(cur).ch == 1) {
-					ch1PESum += 1;
-					pmtAHits.push_back(data.at(cur));
-				}
-				if(data.at(cur).ch == 2) {
-					ch2PESum += 1;
-					pmtBHits.push_back(data.at(cur));
-				}
-				/* integrate the tail end. Add data to the sums of the 
-				 * two channels. */
-				for(tailIt = cur+1; tailIt < data.size(); tailIt++) {
-					if(data.at(tailIt).realtime - data.at(i).realtime > peSumWindow*NANOSECOND) {
-						break;
-					}
-					if(data.at(tailIt).ch == 1) {
-						ch1PESum += 1;
-						pmtAHits.push_back(data.at(tailIt));
-					}
-					if(data.at(tailIt).ch == 2) {
-						ch2PESum += 1;
-						pmtBHits.push_back(data.at(tailIt));
-					}
-				}
-				/* Check to see if we found a neutron */
-				if(ch1PESum + ch2PESum > peSum) {
-					coinc.push_back(data.at(i));
-					coincIndices.push_back(i);
-					pmtACoincHits.push_back(pmtAHits);
-					pmtBCoincHits.push_back(pmtBHits);
-					phsA.Fill(ch1PESum);
-					phsB.Fill(ch2PESum);
-					/* deadtime correction */
-					i = tailIt-1; 
-					cur = tailIt-1;
-					break;
-				}
-				break;
+		}
+	};
+	if(numThreads <= 1 || numChunks == 1) {
+		searchChunks();
+	}
+	else {
+		std::vector<std::thread> threads;
+		long t;
+		for(t = 0; t < std::min((long)numThreads, numChunks); t++) {
+			threads.push_back(std::thread(searchChunks));
+		}
+		for(auto it = threads.begin(); it < threads.end(); it++) {
+			(*it).join();
+		}
+	}
+	
+	/* put the chunks back together in time order */
+	long c;
+	for(c = 0; c < numChunks; c++) {
+		this->mergeCoinc(found[c]);
+	}
+}
+
+/* Coincidence timer -- subset of run */
+void Run::findcoincidenceFixed() {
+	
+	/* we may have searched this run with these settings before */
+	if(this->loadCoincCache()) {
+		return;
+	}
+	
+	/* in streaming mode we walk the run a chunk at a time */
+	if(this->openStream()) {
+		coincResults found = this->newCoincResults();
+		this->findcoincidenceStream(found);
+		this->mergeCoinc(found);
+		this->saveCoincCache();
+		return;
+	}
+	
+	/* check the data table and load it into ROOT tree */
+	if(!this->loadData()) {
+		return;
+	}
+	
+	/* only the dagger hits matter, so search just those */
+	const std::vector<uint32_t>& daggers = this->getChannelIndex(CHMASK(1) | CHMASK(2));
+	if(store != NULL) {
+		this->findcoincidenceDaggers(EventSubset<EventStore>(*store, daggers), false);
+	}
+	else {
+		this->findcoincidenceDaggers(EventSubset<std::vector<input_t> >(data, daggers), false);
+	}
+	this->saveCoincCache();
+}
+
+/* The fixed-window search itself, over the daggers evts (a vector of 
+ * input_t or an EventStore) from first up to end, adding what it finds to 
+ * found. If last is false, evts is only the front of the run: we stop at
+ * the first start event whose windows run off the end of evts and return
+ * its index, so the caller can add more events and pick up from there. */
+template <class Clock, class Events>
+long Run::findcoincidenceFixed(const Events& evts, long first, long end, bool last, coincResults& found) {
+
+	/* the windows, in the clock's units */
+	typename Clock::span coincSpan = Clock::window(coincWindow*NANOSECOND);
+	typename Clock::span tailSpan = Clock::window(peSumWindow*NANOSECOND);
+
+	/* initialize iterators and variables. next is the first event on each
+	 * channel after a start event, and tailEnd the end of the last tail. */
+	long i;
+	long opp;
+	long next[3] = {first, first, first};
+	long tailEnd = first;
+	std::vector<long> pmtAHits;
+	std::vector<long> pmtBHits;
+
+	/* look at each entry of our event vector. */
+	for(i = first; i < end; i++) {
+		typename Clock::span startTime = Clock::at(evts, i);
+
+		/* search forwards for an event on the other channel. If it's not
+		 * inside the coincidence window, we don't have a coincidence! */
+		opp = nextOpposite(evts, i, end, next);
+		if(opp == end || Clock::at(evts, opp) - startTime > coincSpan) {
+			/* we ran out of events before the coincidence window closed */
+			if(!last && opp == end && !(Clock::at(evts, end-1) - startTime > coincSpan)) {
+				return i;
 			}
+			continue;
+		}
+
+		/* integrate the tail end. Start times only go up, so whatever was
+		 * inside the tail of an earlier start event is inside this one. */
+		if(tailEnd <= opp) {
+			tailEnd = opp+1;
+		}
+		while(tailEnd < end && !(Clock::at(evts, tailEnd) - startTime > tailSpan)) {
+			tailEnd++;
+		}
+		/* the tail runs past the events we have, so come back to this one
+		 * once there are more */
+		if(!last && tailEnd == end) {
+			return i;
+		}
+
+		/* Check to see if we found a neutron. Every event from the start to
+		 * the end of the tail counts towards the PE sum. */
+		if(tailEnd - i > peSum) {
+			keepNeutron(evts, i, tailEnd, pmtAHits, pmtBHits, found);
+			/* deadtime correction */
+			i = tailEnd-1;
 		}
 	}
+	return i;
 }
 
 /* Another coincidence timer. The difference between this one and the 
  * other type is that this one keeps track of the previous event. */
 void Run::findcoincidenceMoving() {
 	
-	/* check the data table and load it into the ROOT tree */
-	if(data.empty()) {
-		this->readDataRoot();
+	/* we may have searched this run with these settings before */
+	if(this->loadCoincCache()) {
+		return;
+	}
+	
+	/* in streaming mode we walk the run a chunk at a time */
+	if(this->openStream()) {
+		coincResults found = this->newCoincResults();
+		this->findcoincidenceStream(found);
+		this->mergeCoinc(found);
+		this->saveCoincCache();
+		return;
 	}
-	if(data.empty()) {
+	
+	/* check the data table and load it into the ROOT tree */
+	if(!this->loadData()) {
 		return;
 	}
-
-	/* initialize iterators and variables */
-	int i;
-	int cur = 0;
-	int tailIt = 0;
-	int waveIt = 0;
 	
-	/* initialize variables for our PMT hits */
-	int ch1PESum;
-	int ch2PESum;
-	std::vector<input_t> pmtAHits;
-	std::vector<input_t> pmtBHits;
-	std::vector<long> coincIndices;
-
-	/* look at each entry of the data vector */
-	for(i = 0; i < data.size(); i++) {
-		
-		/* clear previous buffers */
-		ch1PESum = 0;
-		ch2PESum = 0;
-		pmtAHits.clear();
-		pmtBHits.clear();
-		
-		input_t prevEvt;
-		
-		/* for coincidence measurements we only want dagger hits */		
-		if(data.at(i).ch != 1 && data.at(i).ch != 2) { continue; }
-		
-		/* load info into our channel hit vectors */
-		if(data.at(i).ch == 1) {
-			ch1PESum += 1;
-			pmtAHits.push_back(data.at(i));
+	/* only the dagger hits matter, so search just those */
+	const std::vector<uint32_t>& daggers = this->getChannelIndex(CHMASK(1) | CHMASK(2));
+	if(store != NULL) {
+		this->findcoincidenceDaggers(EventSubset<EventStore>(*store, daggers), true);
+	}
+	else {
+		this->findcoincidenceDaggers(EventSubset<std::vector<input_t> >(data, daggers), true);
+	}
+	this->saveCoincCache();
+}
+
+/* The moving-window search itself, over the daggers evts (a vector of 
+ * input_t or an EventStore) from first up to end, adding what it finds to 
+ * found. If last is false, evts is only the front of the run: we stop at
+ * the first start event whose windows run off the end of evts and return
+ * its index, so the caller can add more events and pick up from there. */
+template <class Clock, class Events>
+long Run::findcoincidenceMoving(const Events& evts, long first, long end, bool last, coincResults& found) {
+
+	/* the windows, in the clock's units */
+	typename Clock::span coincSpan = Clock::window(coincWindow*NANOSECOND);
+	typename Clock::span tailSpan = Clock::window(peSumWindow*NANOSECOND);
+
+	/* initialize iterators and variables. next is the first event on each
+	 * channel after a start event, and tailEnd the end of the last tail. */
+	long i;
+	long opp;
+	long next[3] = {first, first, first};
+	long tailEnd = first;
+	std::vector<long> pmtAHits;
+	std::vector<long> pmtBHits;
+
+	/* look at each entry of the event vector */
+	for(i = first; i < end; i++) {
+		typename Clock::span startTime = Clock::at(evts, i);
+
+		/* search forwards for an event on the other channel. If the two 
+		 * are too far apart, it's not a coincidence! */
+		opp = nextOpposite(evts, i, end, next);
+		if(opp == end || Clock::at(evts, opp) - startTime > coincSpan) {
+			/* we ran out of events before the coincidence window closed */
+			if(!last && opp == end && !(Clock::at(evts, end-1) - startTime > coincSpan)) {
+				return i;
+			}
+			continue;
 		}
-		if(data.at(i).ch == 2) {
-			ch2PESum += 1;
-			pmtBHits.push_back(data.at(i));
+
+		/* integrate the tail end, up to the first gap from the previous 
+		 * event longer than peSumWindow. That doesn't depend on the start
+		 * event, so a tail already past opp is still right. */
+		if(tailEnd <= opp) {
+			tailEnd = opp+1;
 		}
-		
-		/* once we've loaded our dataset, search forwards to find coincidence */
-		for(cur = i+1; cur < data.size(); cur++) {
-			
-			/* check the times of our two events. If the two are too far
-			 * apart, break because it's not a coincidence! */
-			if(data.at(cur).realtime - data.at(i).realtime > coincWindow*NANOSECOND) {
-				break;
-			}
-			/* only count coincidences in the dagger */
-			if(data.at(cur).ch != 1 && data.at(cur).ch != 2) { continue; }
-			/* count coincidences if we find a second event in channel i */
-			if(data.at(cur).ch == data.at(i).ch) {
-				if(data.at(i).ch == 1) {
-					ch1PESum += 1;
-					pmtAHits.push_back(data.at(cur));
-				}
-				if(data.at(i).ch == 2) {
-					ch2PESum += 1;
-					pmtBHits.push_back(data.at(cur));
-				}
+		while(tailEnd < end && !(Clock::at(evts, tailEnd) - Clock::at(evts, tailEnd-1) > tailSpan)) {
+			tailEnd++;
+		}
+		/* the tail runs past the events we have, so come back to this one
+		 * once there are more */
+		if(!last && tailEnd == end) {
+			return i;
+		}
+
+		/* check to see if we've found a neutron! Every event from the start
+		 * to the end of the tail counts towards the PE sum. */
+		if(tailEnd - i >= peSum) {
+			keepNeutron(evts, i, tailEnd, pmtAHits, pmtBHits, found);
+			/* put deadtime on counted neutrons */
+			i = tailEnd-1;
+		}
+	}
+	return i;
+}
+
+/* Find the coincidences of every setting in sweep in one pass over the 
+ * daggers. Our own settings and coincidences are left alone. A stream 
+ * can't be searched that way, so there each setting gets a pass of the
+ * regular finder instead. */
+void Run::sweepCoinc(CoincSweep& sweep) {
+	if(this->openStream()) {
+		int saved[4] = {coincWindow, peSumWindow, peSum, coincMode};
+		int k;
+		for(k = 0; k < sweep.getNumSettings(); k++) {
+			const sweepSetting& setting = sweep.getSetting(k);
+			coincWindow = setting.coincWindow;
+			peSumWindow = setting.peSumWindow;
+			peSum = setting.peSum;
+			coincMode = setting.coincMode;
+			if(coincMode != 1 && coincMode != 2) {
+				continue;
 			}
-			/* count our coincidences on different channels */
-			if(data.at(cur).ch != data.at(i).ch) {
-				if(data.at(cur).ch == 1) {
-					ch1PESum += 1;
-					pmtAHits.push_back(data.at(cur));
-				}
-				if(data.at(cur).ch == 2) {
-					ch2PESum += 1;
-					pmtBHits.push_back(data.at(cur));
-				}
-				
-				/* save the previous event as a new data point */
-				prevEvt = data.at(cur);
-				
-				/* integrate the tail end. Add counts into the right 
-				 * channel */
-				for(tailIt = cur+1; tailIt < data.size(); tailIt++) {
-					if((data.at(tailIt).realtime - prevEvt.realtime) > peSumWindow*NANOSECOND) {
-						break;
-					}
-					if(data.at(tailIt).ch != 1 && data.at(tailIt).ch != 2) { continue; }
-					if(data.at(tailIt).ch == 1) {
-						ch1PESum += 1;
-						pmtAHits.push_back(data.at(tailIt));
-					}
-					if(data.at(tailIt).ch == 2) {
-						ch2PESum += 1;
-						pmtBHits.push_back(data.at(tailIt));
-					}
-					prevEvt = data.at(tailIt);
-				}
-				/* check to see if we've found a neutron! */
-				if(ch1PESum + ch2PESum >= peSum) {
-					coinc.push_back(data.at(i));
-					coincIndices.push_back(i);
-					pmtACoincHits.push_back(pmtAHits);
-					pmtBCoincHits.push_back(pmtBHits);
-					phsA.Fill(ch1PESum);
-					phsB.Fill(ch2PESum);
-					/* put deadtime on counted neutrons */
-					i = tailIt-1; 
-					cur = tailIt-1;
-					break;
-				}
-				break;
+			coincResults found = this->newCoincResults();
+			this->openStream();
+			this->findcoincidenceStream(found);
+			for(auto it = found.coinc.begin(); it < found.coinc.end(); it++) {
+				sweep.push(k, *it);
 			}
 		}
+		coincWindow = saved[0];
+		peSumWindow = saved[1];
+		peSum = saved[2];
+		coincMode = saved[3];
+		return;
+	}
+	if(!this->loadData()) {
+		return;
+	}
+	const std::vector<uint32_t>& daggers = this->getChannelIndex(CHMASK(1) | CHMASK(2));
+	if(store != NULL) {
+		sweep.search(EventSubset<EventStore>(*store, daggers));
+	}
+	else {
+		sweep.search(EventSubset<std::vector<input_t> >(data, daggers));
 	}
 }
 
+/* the finders run over the daggers of a loaded run (either storage) or of
+ * a streamed chunk, with either clock */
+template long Run::findcoincidenceFixed<tickClock>(const std::vector<input_t>& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceFixed<tickClock>(const EventSubset<std::vector<input_t> >& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceFixed<tickClock>(const EventSubset<EventStore>& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceFixed<realtimeClock>(const std::vector<input_t>& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceFixed<realtimeClock>(const EventSubset<std::vector<input_t> >& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceFixed<realtimeClock>(const EventSubset<EventStore>& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceMoving<tickClock>(const std::vector<input_t>& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceMoving<tickClock>(const EventSubset<std::vector<input_t> >& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceMoving<tickClock>(const EventSubset<EventStore>& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceMoving<realtimeClock>(const std::vector<input_t>& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceMoving<realtimeClock>(const EventSubset<std::vector<input_t> >& evts, long first, long end, bool last, coincResults& found);
+template long Run::findcoincidenceMoving<realtimeClock>(const EventSubset<EventStore>& evts, long first, long end, bool last, coincResults& found);
+
 /* Removing code to make it easier to read
  * //				if(data.at(cur).ch == 1) {pmtAHits.push_back(data.at(cur));}
 //				if(data.at(cur).ch == 2) {pmtBHits.push_back(data.at(cur));}
@@ -1,4 +1,5 @@
 #include "../inc/Run.hpp"
+#include "../inc/EventStore.hpp"
 
 /*	------------------------------------------------------------------------------------------------
 	Author: Nathan B. Callahan
@@ -13,6 +14,10 @@
 	Ideally it would work to find when Channel 4 goes from FALSE to TRUE for the second time, but
 	there appears to be some jitter in the IO register, which fluctuates between TRUE and FALSE so
 	it would be difficult in practice. Instead, we will just use a simple threshold.
+
+	Analyses ask for many edges of the same bit (every H-GX pulse, every dagger step), so the first
+	call for a mask finds all of its stable edges in one pass and keeps them. Every call after that
+	is a binary search for the first edge after the offset.
 	------------------------------------------------------------------------------------------------	*/
 	
 /* This function looks at the IO register to check whether or not the 
@@ -21,37 +26,113 @@
 double Run::getTagBitEvt(int mask, double offset, bool edge) {
 	
 	/* initialize ROOT data tree */
-	bool armed = false;
-	if(data.empty()) {
-		this->readDataRoot();
+	if(this->openStream()) {
+		return this->getTagBitEvtStream(mask, offset, edge);
 	}
 	
 	/* throw an error if there is no data */
-	if(data.empty()) {
+	if(!this->loadData()) {
 		return -1.0;
 	}
 	
+	/* find every stable edge of this mask the first time we're asked */
+	auto found = edgeIndex.find(mask);
+	if(found == edgeIndex.end()) {
+		found = edgeIndex.insert(std::make_pair(mask, tagEdges())).first;
+		if(store != NULL) {
+			this->findTagEdges(*store, mask, found->second);
+		}
+		else {
+			this->findTagEdges(data, mask, found->second);
+		}
+	}
+	
+	/* runs that weren't sorted (e.g. counts handed to the constructor) 
+	 * can't be searched, so scan them the old way */
+	if(!found->second.ordered) {
+		if(store != NULL) {
+			return this->findTagBitEvt(*store, mask, offset, edge);
+		}
+		return this->findTagBitEvt(data, mask, offset, edge);
+	}
+	
+	/* the first stable edge after our offset */
+	const std::vector<double>& times = edge ? found->second.rising : found->second.falling;
+	auto next = std::upper_bound(times.begin(), times.end(), offset);
+	if(next == times.end()) {
+		return -1.0;
+	}
+	return *next;
+}
+
+/* Find all the stable edges that findTagBitEvt could return for mask, in
+ * one pass. An edge (the tag bit changing, after the first two data 
+ * points) is stable if the bit holds for more than 0.2s after it. Since 
+ * the bit is constant until the next edge, that's just checking the time
+ * to the next edge (or the end of the run). */
+template <class Events>
+void Run::findTagEdges(const Events& evts, int mask, tagEdges& edges) {
+	long size = evts.size();
+	long i;
+	long last = -1;
+	
+	/* an edge waiting for the next one to decide if it's stable */
+	auto settle = [&evts, &edges, mask](long edgeIt, long endIt)->void{
+		if(eventRealtime(evts, endIt) - eventRealtime(evts, edgeIt) > 0.2) {
+			if(eventTag(evts, edgeIt) & mask) {
+				edges.rising.push_back(eventRealtime(evts, edgeIt));
+			}
+			else {
+				edges.falling.push_back(eventRealtime(evts, edgeIt));
+			}
+		}
+	};
+	
+	edges.ordered = true;
+	for(i = 1; i < size; i++) {
+		if(eventRealtime(evts, i) < eventRealtime(evts, i-1)) {
+			edges.ordered = false;
+		}
+		if(!(eventTag(evts, i) & mask) == !(eventTag(evts, i-1) & mask)) {
+			continue;
+		}
+		if(last >= 0) {
+			settle(last, i);
+		}
+		last = i > 2 ? i : -1;
+	}
+	if(last >= 0) {
+		settle(last, size-1);
+	}
+}
+
+/* The search itself, over either storage. This is the original linear 
+ * scan, used for runs that aren't in time order. */
+template <class Events>
+double Run::findTagBitEvt(const Events& evts, int mask, double offset, bool edge) {
+	
 	/* initialize iterator variables */
-	int i;
-	int j;
+	long i;
+	long j;
+	long size = evts.size();
 	
 	/* loop through all points the data is output */
-	for(i = 0; i < data.size(); i++) {
+	for(i = 0; i < size; i++) {
 		/* check if the time of the data is greater than the sensitivity
 		 * of our experiment */
-		if(data.at(i).realtime > offset) {
+		if(eventRealtime(evts, i) > offset) {
 			/* ignore the first two data points */
 			if(i > 2) {
 				/* return the time if edge (an input bool) is true, the 
 				 * current event is high, and the previous event is low */
-				if(edge && (data.at(i).tag & mask) && !(data.at(i-1).tag & mask)) {
-					for(j = i+1; j < data.size(); j++) {
+				if(edge && (eventTag(evts, i) & mask) && !(eventTag(evts, i-1) & mask)) {
+					for(j = i+1; j < size; j++) {
 						/* check that the data is consistent for >0.2s */
-						if(data.at(j).realtime - data.at(i).realtime > 0.2) {
-							return data.at(i).realtime;
+						if(eventRealtime(evts, j) - eventRealtime(evts, i) > 0.2) {
+							return eventRealtime(evts, i);
 						}
 						/* keep searching if there's a problem */
-						if(!(data.at(j).tag & mask)) {
+						if(!(eventTag(evts, j) & mask)) {
 							break;
 						}
 					}
@@ -59,14 +140,14 @@ double Run::getTagBitEvt(int mask, double offset, bool edge) {
 				
 				/* return the time if edge (an input bool) is true, the 
 				 * current event is low, and the previous event is high */
-				else if(!edge && !(data.at(i).tag & mask) && (data.at(i-1).tag & mask)) {
-					for(j = i+1; j < data.size(); j++) {
+				else if(!edge && !(eventTag(evts, i) & mask) && (eventTag(evts, i-1) & mask)) {
+					for(j = i+1; j < size; j++) {
 						/* check that the data is consistent for >0.2s */
-						if(data.at(j).realtime - data.at(i).realtime > 0.2) {
-							return data.at(i).realtime;
+						if(eventRealtime(evts, j) - eventRealtime(evts, i) > 0.2) {
+							return eventRealtime(evts, i);
 						}
 						/* keep searching if there's a problem */
-						if(data.at(j).tag & mask) {
+						if(eventTag(evts, j) & mask) {
 							break;
 						}
 					}
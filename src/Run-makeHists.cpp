@@ -1,4 +1,7 @@
 #include "../inc/Run.hpp"
+#include "../inc/EventStore.hpp"
+#include "../inc/EventScan.hpp"
+#include "../inc/EventView.hpp"
 
 /*----------------------------------------------------------------------
 	Author: Nathan B. Callahan (?)
@@ -10,14 +13,49 @@ the data files easier.
 
 -----------------------------------------------------------------------*/
 
-/* This function takes two inputs the functional expression and the 
- * selected data, and produces a histogram. */
-TH1D Run::getCoincHist(const std::function <double (input_t)>& expr,
-					   const std::function <bool (input_t)>& selection)
-{
-	
-	/* check to load our ROOT tree, depending on whether we are in singles
-	 * or doubles mode. */
+/* Copy the events passing selection out of either storage, or a subset 
+ * of one */
+template <class Events>
+static void selectEvents(const Events& evts, const std::function <bool (input_t)>& selection, std::vector<input_t>& filtered) {
+	long i;
+	for(i = 0; i < (long)evts.size(); i++) {
+		input_t event = eventAt(evts, i);
+		if(selection(event)) {
+			filtered.push_back(event);
+		}
+	}
+}
+
+/* Packed runs are handed to the templated queries this many events at a
+ * time */
+#define EVENTBLOCK 4096
+
+/* Point block at the loaded events starting at first, and return how 
+ * many there are (0 once we're past the end). A packed run is unpacked a
+ * block at a time into scratch. */
+long Run::getEventBlock(long first, std::vector<input_t>& scratch, const input_t*& block) {
+	if(store == NULL) {
+		if(first >= (long)data.size()) {
+			return 0;
+		}
+		block = data.data() + first;
+		return data.size() - first;
+	}
+	long num = std::min((long)store->size() - first, (long)EVENTBLOCK);
+	if(num <= 0) {
+		return 0;
+	}
+	scratch.resize(num);
+	long i;
+	for(i = 0; i < num; i++) {
+		scratch[i] = store->get(first + i);
+	}
+	block = scratch.data();
+	return num;
+}
+
+/* Find the coincidences if we haven't yet */
+void Run::loadCoinc() {
 	if(coinc.empty()) {
 		if(coincMode == 1) {
 			this->findcoincidenceFixed();
@@ -26,37 +64,51 @@ TH1D Run::getCoincHist(const std::function <double (input_t)>& expr,
 			this->findcoincidenceMoving();
 		}
 	}
-	
-	/* close function if we select an empty set */
-	if(coinc.empty()) {
-		TH1D hist("Empty_histo", "Empty_histo", 10, 0, 10);
+}
+
+/* Fill a histogram with one bin per unit between the floor and ceiling
+ * of points, or return an empty one with emptyBins bins */
+TH1D Run::fillUnitHist(const std::vector<double>& points, int emptyBins) {
+	if(points.empty()) {
+		TH1D hist("Empty_histo", "Empty_histo", emptyBins, 0, emptyBins);
+		hist.SetDirectory(0);
 		return hist;
 	}
-	
-	/* initialize our data vectors (in a unique input_t class) */
-	std::vector<input_t> filtered;
-	std::copy_if(coinc.begin(), coinc.end(), std::back_inserter(filtered), selection);
-	
-	/* close function if we select an empty set */
-	if(filtered.empty()) {
-		TH1D hist("Empty_histo", "Empty_histo", 10, 0, 10);
-		return hist;
+	double min = *std::min_element(points.begin(), points.end());
+	double max = *std::max_element(points.begin(), points.end());
+	double low = floor(min);
+	double high = ceil(max);
+	
+	/* every point on the same integer would leave no range at all, so
+	 * they get the unit bin that starts there */
+	if(high <= low) {
+		high = low + 1.0;
 	}
+	FastHist hist("histo", "histo", high - low, low, high);
+	std::for_each(points.begin(), points.end(), [&hist](double point)->void{hist.fill(point);});
+	return hist.toTH1D();
+}
+
+/* This function takes two inputs the functional expression and the 
+ * selected data, and produces a histogram. */
+TH1D Run::getCoincHist(const std::function <double (input_t)>& expr,
+					   const std::function <bool (input_t)>& selection)
+{
 	
-	/* load the min and max from our filtered dataset, with bounds set by 
-	 * some functional expressions on arbitrary x and y */
-	input_t min = *std::min_element(filtered.begin(), filtered.end(), [expr](input_t x, input_t y)->bool{return(expr(x) < expr(y));});
-	input_t max = *std::max_element(filtered.begin(), filtered.end(), [expr](input_t x, input_t y)->bool{return(expr(x) < expr(y));});
-	
-	/* if we haven't closed out yet, create a histogram */
-	TH1D hist("histo", "histo", ceil(expr(max))-floor(expr(min)), floor(expr(min)), ceil(expr(max)));
-	
-	/* loop our histogram through our whole analysis code, and modify
-	 * histogram in our coincidence runs. */
-	std::for_each(filtered.begin(), filtered.end(), [&hist, expr](input_t event)->void{hist.Fill(expr(event));});
+	/* check to load our ROOT tree, depending on whether we are in singles
+	 * or doubles mode. */
+	this->loadCoinc();
 	
-	/* output is our coincidence histogram */
-	return hist;
+	/* evaluate our expression once for each selected coincidence, then
+	 * bin them between the floor of the smallest and ceiling of the 
+	 * largest. An empty selection gives an empty histogram. */
+	std::vector<double> points;
+	for(auto it = coinc.begin(); it < coinc.end(); it++) {
+		if(selection(*it)) {
+			points.push_back(expr(*it));
+		}
+	}
+	return fillUnitHist(points, 10);
 }
 
 /* This function takes the same inputs as our other coincidence hist
@@ -65,41 +117,39 @@ TH1D Run::getCoincHist(const std::function <double (input_t)>& expr,
 TH1D Run::getHist(const std::function <double (input_t)>& expr,
 				  const std::function <bool (input_t)>& selection)
 {
-	/* load our ROOT tree into the data */
-	if(data.empty()) {
-		this->readDataRoot();
+	/* in streaming mode we never load the data */
+	if(this->openStream()) {
+		return this->getHistStream(expr, selection);
 	}
 	
-	/* make sure we've actually picked a data set with data. If not, then
-	 * close with an empty histogram */
-	if(data.empty()) {
+	/* load our ROOT tree into the data, and make sure we've actually 
+	 * picked a data set with data. If not, then close with an empty 
+	 * histogram */
+	if(!this->loadData()) {
 		TH1D hist("Empty_histo", "Empty_histo", 0, 0, 0);
+		hist.SetDirectory(0);
 		return hist;
 	}
 	
-	/* initialize data vectors */
-	std::vector<input_t> filtered;
-	std::copy_if(data.begin(), data.end(), std::back_inserter(filtered), selection);
-	
-	/* check to make sure our data vectors actually exist. */
-	if(filtered.empty()) {
-		TH1D hist("Empty_histo", "Empty_histo", 0, 0, 0);
-		return hist;
+	/* evaluate our expression once for each selected event */
+	std::vector<double> points;
+	std::vector<input_t> scratch;
+	const input_t* block;
+	long first = 0;
+	long num;
+	long i;
+	while((num = this->getEventBlock(first, scratch, block)) > 0) {
+		for(i = 0; i < num; i++) {
+			if(selection(block[i])) {
+				points.push_back(expr(block[i]));
+			}
+		}
+		first += num;
 	}
 	
-	/* load the min and max from our filtered data set, defined through 
-	 * some functional we're acting on with x and y */
-	input_t min = *std::min_element(filtered.begin(), filtered.end(), [expr](input_t x, input_t y)->bool{return(expr(x) < expr(y));});
-	input_t max = *std::max_element(filtered.begin(), filtered.end(), [expr](input_t x, input_t y)->bool{return(expr(x) < expr(y));});
-	
-	/* initialize our histogram */
-	TH1D hist("histo", "histo", ceil(expr(max))-floor(expr(min)), floor(expr(min)), ceil(expr(max)));
-	
-	/* loop our histogram through the analyzer software. */
-	std::for_each(filtered.begin(), filtered.end(), [&hist, expr](input_t event)->void{hist.Fill(expr(event));});
-	
-	/* output our final histogram */
-	return hist;
+	/* bin them between the floor of the smallest and ceiling of the
+	 * largest */
+	return fillUnitHist(points, 0);
 }
 
 /* This histogram only takes the start and endtimes of a dataset, and 
@@ -108,6 +158,7 @@ TH1D Run::getDeadtimeHist(double start, double end) {
 	
 	/* initialize histogram with input ranges */
 	TH1D deadTimeHist("deadTime", "deadTime", ceil(end)-floor(start), floor(start), ceil(end));
+	deadTimeHist.SetDirectory(0);
 	
 	/* load in coincidence data from ROOT */
 	if(coinc.empty()) {
@@ -124,28 +175,24 @@ TH1D Run::getDeadtimeHist(double start, double end) {
 		return deadTimeHist;
 	}
 	
-	/* initialize data variables. Assume the coincidence hits vectors 
-	 * were filled together and thus have the same number of entries */
-	auto pmtAit = pmtACoincHits.begin();
-	auto pmtBit = pmtBCoincHits.begin();
-	std::vector<input_t> pmtAwaveform;
-	std::vector<input_t> pmtBwaveform;
+	/* initialize data variables. The coincidence hits of A and B were 
+	 * filled together and thus have the same number of entries */
+	long k;
 	double firstCountTime;
 	double lastCountTime;
 	double deadTime;
 	
-	/* loop through the coincidence hits on pmtA. If A and B have the 
-	 * same length this will still work, we increment B at the end. */
-	for(pmtAit = pmtACoincHits.begin(); pmtAit < pmtACoincHits.end(); pmtAit++) {
+	/* loop through the coincidences, looking at the hits on both PMTs */
+	for(k = 0; k < pmtACoincHits.size(); k++) {
 		
-		/* load our waveforms by calling the location of our iterators */
-		pmtAwaveform = *pmtAit;
-		pmtBwaveform = *pmtBit;
+		/* view our waveforms in place, we only want their ends */
+		EventView pmtAwaveform = this->getHitsView(pmtACoincHits, k);
+		EventView pmtBwaveform = this->getHitsView(pmtBCoincHits, k);
 
 		/* take the first and last count times for both A waveforms and B
 		 * waveforms. Take the minimum and maximum of both of these*/
-		firstCountTime = std::min(pmtAwaveform.front().realtime, pmtBwaveform.front().realtime);
-		lastCountTime = std::max(pmtAwaveform.back().realtime, pmtBwaveform.back().realtime);
+		firstCountTime = std::min(pmtAwaveform.getRealtime(0), pmtBwaveform.getRealtime(0));
+		lastCountTime = std::max(pmtAwaveform.getRealtime(pmtAwaveform.size()-1), pmtBwaveform.getRealtime(pmtBwaveform.size()-1));
 		
 		/* check to make sure the count time is in the right bounds */
 		if(firstCountTime > start && firstCountTime < end) {
@@ -155,7 +202,6 @@ TH1D Run::getDeadtimeHist(double start, double end) {
 			deadTime = lastCountTime-firstCountTime;
 			deadTimeHist.Fill(firstCountTime, deadTime);		
 		}
-		pmtBit++;
 	}
 	return deadTimeHist;
 }
@@ -166,39 +212,24 @@ std::vector<double> Run::getPhotonTracesVect(int pmt,
 											 const std::function <bool (std::vector<input_t>)>& selection)
 {
 	
-	/* initialize the photon vector, which requires some data from the 
-	 * coincidence hits vector. Also initialize the data vectors. */
-	std::vector<std::vector<input_t> > *photonVect = pmt == 1 ? &pmtACoincHits : &pmtBCoincHits;
-	std::vector<std::vector<input_t> > filtered;
+	/* initialize the photon hits and the data vectors. Each trace is
+	 * copied into the same vector in turn for the callbacks. */
+	const coincHits& photonHits = pmt == 1 ? pmtACoincHits : pmtBCoincHits;
+	std::vector<input_t> trace;
 	std::vector<double> mapped;
 
 	/* load data from ROOT depending on what the coincidence mode is*/   
-	if(coinc.empty()) {
-		if(coincMode == 1) {
-			this->findcoincidenceFixed();
-		}
-		else if(coincMode == 2) {
-			this->findcoincidenceMoving();
+	this->loadCoinc();
+	
+	/* pick a particular selection of the traces and transform them */
+	long k;
+	for(k = 0; k < photonHits.size(); k++) {
+		this->copyPhotonTrace(pmt, k, trace);
+		if(selection(trace)) {
+			mapped.push_back(expr(trace));
 		}
 	}
 	
-	/* see if the photon vector exists. If it doesn't, end. */
-	if(photonVect->empty()) {
-		return mapped;
-	}
-	
-	/* copy the photon vector to pick a particular selection from this */
-	std::copy_if(photonVect->begin(), photonVect->end(), std::back_inserter(filtered), selection);
-	
-	/* close if we picked the wrong dataset */
-	if(filtered.empty()) {
-		return mapped;
-	}
-	
-	/* load a transform vector to modify our dataset and load the photon
-	 * traces */
-	std::transform(filtered.begin(), filtered.end(), std::back_inserter(mapped), expr);
-	
 	return mapped;
 }
 
@@ -210,26 +241,38 @@ TH1D Run::getHistIterator(const std::function <double (std::vector<input_t>::ite
 													   std::vector<input_t>::iterator,
 													   std::vector<input_t>::iterator)>& selection)
 {
-	/* check the data and read into ROOT */
-	if(data.empty()) {
-		this->readDataRoot();
+	/* check the data and read into ROOT. Our callbacks need iterators 
+	 * into the whole run, so a streamed run has to be loaded here. */
+	if(data.empty() && store == NULL && !streamTree.empty()) {
+		fprintf(stderr, "getHistIterator can't stream, loading %s!\n", streamTree.c_str());
+		this->readDataRoot(streamTree.c_str());
+		this->packData();
 	}
 	
 	/* close if we accidentally load a bad dataset*/
-	if(data.empty()) {
+	if(!this->loadData()) {
 		TH1D hist("Empty_histo", "Empty_histo", 10, 0, 10);
+		hist.SetDirectory(0);
 		return hist;
 	}
 	
+	/* the callbacks need real iterators, so a packed run is unpacked
+	 * for the length of this call */
+	std::vector<input_t> unpacked;
+	if(store != NULL) {
+		store->unpack(unpacked);
+	}
+	std::vector<input_t>& evts = store != NULL ? unpacked : data;
+	
 	/* initialize data vectors and iterators */
 	std::vector<double> points;
 	std::vector<input_t>::iterator it;
 	
 	/* loop through our data points and select the ones that we want in
 	 * our histogram */
-	for(it = data.begin(); it < data.end(); it++) {
-		if(selection(it, data.begin(), data.end()) == true) {
-			points.push_back(expr(it, data.begin(), data.end()));
+	for(it = evts.begin(); it < evts.end(); it++) {
+		if(selection(it, evts.begin(), evts.end()) == true) {
+			points.push_back(expr(it, evts.begin(), evts.end()));
 		}
 	}
 	
@@ -247,16 +290,21 @@ TH1D Run::getHistIterator(const std::function <double (std::vector<input_t>::ite
 		min = 0;
 		max = 1;
 	}
+	
+	/* all the points at one value: give them a unit wide range */
+	if(max <= min) {
+		max = min + 1;
+	}
 
 	/* create our histogram */
-	TH1D hist("histo", "histo", 1000, min, max);
+	FastHist hist("histo", "histo", 1000, min, max);
 	printf("min: %f; max: %f\n", min, max);
 	
 	/* run our produced histograms through the analyzer */
 	if(points.size() > 0) {
-		std::for_each(points.begin(), points.end(), [&hist](double point)->void{hist.Fill(point);});
+		std::for_each(points.begin(), points.end(), [&hist](double point)->void{hist.fill(point);});
 	}
-	return hist;
+	return hist.toTH1D();
 }
 
 /* Find the total number of coincidence counts in our data set */
@@ -292,18 +340,263 @@ std::vector<input_t> Run::getCounts(const std::function <input_t (input_t)>& exp
 	std::vector<input_t> filtered;
 	std::vector<input_t> transformed;
 	
-	/* load our root tree */
-	if(data.empty()) {
-		this->readDataRoot();
+	/* in streaming mode we never load the data */
+	if(this->openStream()) {
+		return this->getCountsStream(expr, selection);
 	}
+	
+	/* load our root tree */
+	this->loadData();
 		
 	/* copy and transform our data sets to find the total amount of counts */
-	std::copy_if(data.begin(), data.end(), std::back_inserter(filtered), selection);
+	if(store != NULL) {
+		selectEvents(*store, selection, filtered);
+	}
+	else {
+		std::copy_if(data.begin(), data.end(), std::back_inserter(filtered), selection);
+	}
 	std::transform(filtered.begin(), filtered.end(), std::back_inserter(transformed), expr);
 	
 	return transformed;
 }
 
+/* Same as getHist, but only looks at the events on the channels in chMask
+ * (see CHMASK) instead of scanning the whole run. */
+TH1D Run::getHist(uint32_t chMask,
+				  const std::function <double (input_t)>& expr,
+				  const std::function <bool (input_t)>& selection)
+{
+	/* in streaming mode we never load the data, so just add the mask to
+	 * the selection */
+	if(this->openStream()) {
+		return this->getHistStream(expr, [chMask, &selection](input_t x)->bool{return inChannelMask(x.ch, chMask) && selection(x);});
+	}
+	
+	/* make sure we've actually picked a data set with data */
+	if(!this->loadData()) {
+		TH1D hist("Empty_histo", "Empty_histo", 0, 0, 0);
+		hist.SetDirectory(0);
+		return hist;
+	}
+	
+	/* pull the selected events out of our channels only */
+	std::vector<input_t> filtered;
+	const std::vector<uint32_t>& index = this->getChannelIndex(chMask);
+	if(store != NULL) {
+		selectEvents(EventSubset<EventStore>(*store, index), selection, filtered);
+	}
+	else {
+		selectEvents(EventSubset<std::vector<input_t> >(data, index), selection, filtered);
+	}
+	
+	/* evaluate our expression once per event and bin them */
+	std::vector<double> points;
+	points.reserve(filtered.size());
+	std::transform(filtered.begin(), filtered.end(), std::back_inserter(points), expr);
+	return fillUnitHist(points, 0);
+}
+
+/* Same as getCounts, but only looks at the events on the channels in 
+ * chMask (see CHMASK) instead of scanning the whole run. */
+std::vector<input_t> Run::getCounts(uint32_t chMask,
+				  const std::function <input_t (input_t)>& expr,
+				  const std::function <bool (input_t)>& selection)
+{
+	/* load our data vectors */
+	std::vector<input_t> filtered;
+	std::vector<input_t> transformed;
+	
+	/* in streaming mode we never load the data, so just add the mask to
+	 * the selection */
+	if(this->openStream()) {
+		return this->getCountsStream(expr, [chMask, &selection](input_t x)->bool{return inChannelMask(x.ch, chMask) && selection(x);});
+	}
+	if(!this->loadData()) {
+		return transformed;
+	}
+	
+	/* copy and transform the selected events from our channels only */
+	const std::vector<uint32_t>& index = this->getChannelIndex(chMask);
+	if(store != NULL) {
+		selectEvents(EventSubset<EventStore>(*store, index), selection, filtered);
+	}
+	else {
+		selectEvents(EventSubset<std::vector<input_t> >(data, index), selection, filtered);
+	}
+	std::transform(filtered.begin(), filtered.end(), std::back_inserter(transformed), expr);
+	
+	return transformed;
+}
+
+/* Get the events on the channels in chMask with realtime in [t0, t1), 
+ * transformed by expr. The window is found by binary search, so this only
+ * touches the events it returns. For an open lower edge pass 
+ * nextafter(t0, INFINITY). */
+std::vector<input_t> Run::getCounts(uint32_t chMask, double t0, double t1,
+				  const std::function <input_t (input_t)>& expr)
+{
+	std::vector<input_t> transformed;
+	
+	/* in streaming mode we can't search, so just scan for the window */
+	if(this->openStream()) {
+		return this->getCountsStream(expr, [chMask, t0, t1](input_t x)->bool{return inChannelMask(x.ch, chMask) && x.realtime >= t0 && x.realtime < t1;});
+	}
+	if(!this->loadData()) {
+		return transformed;
+	}
+	
+	const std::vector<uint32_t>& index = this->getChannelIndex(chMask);
+	long first, last, i;
+	this->findTimeRange(index, t0, t1, first, last);
+	transformed.reserve(last - first);
+	for(i = first; i < last; i++) {
+		transformed.push_back(expr(store != NULL ? store->get(index[i]) : data[index[i]]));
+	}
+	
+	return transformed;
+}
+
+/* Number of events on the channels in chMask with realtime in [t0, t1) */
+long Run::getNumCounts(uint32_t chMask, double t0, double t1) {
+	if(this->openStream()) {
+		return this->getCounts(chMask, t0, t1, [](input_t x)->input_t{return x;}).size();
+	}
+	if(!this->loadData()) {
+		return 0;
+	}
+	long first, last;
+	this->findTimeRange(this->getChannelIndex(chMask), t0, t1, first, last);
+	return last - first;
+}
+
+/* Answer all of a scan's queries in one pass over the run */
+void Run::scanCounts(EventScan& scan) {
+	if(this->openStream()) {
+		this->scanCountsStream(scan);
+		return;
+	}
+	if(!this->loadData()) {
+		return;
+	}
+	std::vector<input_t> scratch;
+	const input_t* block;
+	long first = 0;
+	long num;
+	long i;
+	while((num = this->getEventBlock(first, scratch, block)) > 0) {
+		for(i = 0; i < num; i++) {
+			scan.push(block[i]);
+		}
+		first += num;
+	}
+}
+
+/* Answer all of a scan's queries in one pass over the coincidences */
+void Run::scanCoincCounts(EventScan& scan) {
+	this->loadCoinc();
+	for(auto it = coinc.begin(); it < coinc.end(); it++) {
+		scan.push(*it);
+	}
+}
+
+/* A view of the events on the channels in chMask with realtime in 
+ * [t0, t1). This is just a slice of the channel index, nothing is copied. */
+EventView Run::getCountsView(uint32_t chMask, double t0, double t1) {
+	/* a stream has nothing to point into, so the view gets a copy */
+	if(this->openStream()) {
+		std::shared_ptr<std::vector<input_t> > events(new std::vector<input_t>(this->getCounts(chMask, t0, t1, [](input_t x)->input_t{return x;})));
+		return EventView(events);
+	}
+	if(!this->loadData()) {
+		return EventView();
+	}
+	const std::vector<uint32_t>& index = this->getChannelIndex(chMask);
+	long first, last;
+	this->findTimeRange(index, t0, t1, first, last);
+	if(store != NULL) {
+		return EventView(*store, index.data() + first, last - first);
+	}
+	return EventView(data, index.data() + first, last - first);
+}
+
+/* A view of the events passing selection. Only their positions are kept. */
+EventView Run::getCountsView(const std::function <bool (input_t)>& selection) {
+	if(this->openStream()) {
+		std::shared_ptr<std::vector<input_t> > events(new std::vector<input_t>(this->getCountsStream([](input_t x)->input_t{return x;}, selection)));
+		return EventView(events);
+	}
+	if(!this->loadData()) {
+		return EventView();
+	}
+	std::shared_ptr<std::vector<uint32_t> > index(new std::vector<uint32_t>());
+	std::vector<input_t> scratch;
+	const input_t* block;
+	long first = 0;
+	long num;
+	long i;
+	while((num = this->getEventBlock(first, scratch, block)) > 0) {
+		for(i = 0; i < num; i++) {
+			if(selection(block[i])) {
+				index->push_back(first + i);
+			}
+		}
+		first += num;
+	}
+	if(store != NULL) {
+		return EventView(*store, index);
+	}
+	return EventView(data, index);
+}
+
+/* A view of the coincidences passing selection */
+EventView Run::getCoincView(const std::function <bool (input_t)>& selection) {
+	this->loadCoinc();
+	std::shared_ptr<std::vector<uint32_t> > index(new std::vector<uint32_t>());
+	long i;
+	for(i = 0; i < (long)coinc.size(); i++) {
+		if(selection(coinc[i])) {
+			index->push_back(i);
+		}
+	}
+	return EventView(coinc, index);
+}
+
+/* The number of coincidences we have photon traces for */
+long Run::getNumPhotonTraces() {
+	this->loadCoinc();
+	return pmtACoincHits.size();
+}
+
+/* A view of the hits of coincidence k on pmt (1 for A, else B) */
+EventView Run::getPhotonTrace(int pmt, long k) {
+	this->loadCoinc();
+	return this->getHitsView(pmt == 1 ? pmtACoincHits : pmtBCoincHits, k);
+}
+
+/* The hits of coincidence k, wherever they were kept */
+EventView Run::getHitsView(const coincHits& hits, long k) {
+	if(!copiedHits.empty()) {
+		return EventView(copiedHits, hits.hits(k), hits.numHits(k));
+	}
+	
+	/* coincidences from the cache can come before the events do */
+	this->loadData();
+	if(store != NULL) {
+		return EventView(*store, hits.hits(k), hits.numHits(k));
+	}
+	return EventView(data, hits.hits(k), hits.numHits(k));
+}
+
+/* Copy the hits of coincidence k on pmt into trace, reusing its memory */
+void Run::copyPhotonTrace(int pmt, long k, std::vector<input_t>& trace) {
+	EventView view = this->getHitsView(pmt == 1 ? pmtACoincHits : pmtBCoincHits, k);
+	trace.resize(view.size());
+	long j;
+	for(j = 0; j < view.size(); j++) {
+		trace[j] = view[j];
+	}
+}
+
 /*-----------------------------------------------------------------------------------------------
  * Extra code goes here
  * //printf("Count time, length: %e, %e\n", firstCountTime, lastCountTime-firstCountTime);
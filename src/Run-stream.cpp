@@ -0,0 +1,225 @@
+#include "../inc/Run.hpp"
+#include "../inc/EventStream.hpp"
+#include "../inc/EventScan.hpp"
+#include "../inc/EventStore.hpp"
+#include "TList.h"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	These functions are the streaming versions of the Run analyses. When a memory budget is set
+	(Run::setMemoryBudget), a Run never fills data. Instead each analysis walks the time-sorted
+	event stream from EventStream a chunk at a time, so peak memory is set by the budget and not
+	by the length of the run.
+
+	Only the tmcs trees can be streamed. The mcs_events trees need the tag bit demultiplexing in
+	readDataRoot, which looks back over everything decoded so far, so those are still loaded whole.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Set up (or rewind) the event stream. Returns false if we aren't streaming
+ * or can't stream this file, in which case the caller falls back to data. */
+bool Run::openStream() {
+	if(memoryBudget == 0 || !data.empty() || store != NULL) {
+		return false;
+	}
+	if(stream != NULL) {
+		stream->rewind();
+		return true;
+	}
+	if(this->exists() == false) {
+		return false;
+	}
+	TList* list = dataFile->GetListOfKeys();
+	if(list == NULL) {
+		return false;
+	}
+
+	/* pick the same tree readDataRoot would. tmcs_1 gets its realtime
+	 * rebuilt from the clock, trees asked for by name are used as is. */
+	TTree* rawData = NULL;
+	bool recomputeRealtime = false;
+	if(!streamTree.empty()) {
+		if(list->Contains(streamTree.c_str())) {
+			dataFile->GetObject(streamTree.c_str(), rawData);
+		}
+	}
+	else if(list->Contains("tmcs_1")) {
+		dataFile->GetObject("tmcs_1", rawData);
+		recomputeRealtime = true;
+	}
+	else if(list->Contains("mcs_events")) {
+		fprintf(stderr, "Can't stream mcs_events trees, loading the whole run!\n");
+	}
+	if(rawData == NULL) {
+		return false;
+	}
+
+	stream = new EventStream(rawData, recomputeRealtime, memoryBudget);
+	if(!stream->isValid()) {
+		delete stream;
+		stream = NULL;
+		return false;
+	}
+	return true;
+}
+
+/* Find coincidences chunk by chunk, comparing clock ticks if every realtime
+ * in the stream comes from the clock */
+void Run::findcoincidenceStream(coincResults& found) {
+	if(stream->realtimeFromTicks()) {
+		this->findcoincidenceStream<tickClock>(found);
+	}
+	else {
+		this->findcoincidenceStream<realtimeClock>(found);
+	}
+}
+
+/* Only the daggers of each chunk are searched. Whatever the finder couldn't
+ * decide at the end of a chunk (an open coincidence or peSum window) is 
+ * carried over to the front of the next one. */
+template <class Clock>
+void Run::findcoincidenceStream(coincResults& found) {
+	std::vector<input_t> chunk;
+	std::vector<input_t> window;
+	long resume;
+
+	while(stream->next(chunk)) {
+		for(auto it = chunk.begin(); it < chunk.end(); it++) {
+			if((*it).ch == 1 || (*it).ch == 2) {
+				window.push_back(*it);
+			}
+		}
+		if(coincMode == 1) {
+			resume = this->findcoincidenceFixed<Clock>(window, 0, window.size(), false, found);
+		}
+		else {
+			resume = this->findcoincidenceMoving<Clock>(window, 0, window.size(), false, found);
+		}
+		window.erase(window.begin(), window.begin() + resume);
+	}
+
+	/* finish off whatever is still open at the end of the run */
+	if(coincMode == 1) {
+		this->findcoincidenceFixed<Clock>(window, 0, window.size(), true, found);
+	}
+	else {
+		this->findcoincidenceMoving<Clock>(window, 0, window.size(), true, found);
+	}
+}
+
+/* Select and transform counts one chunk at a time. Only the selected
+ * counts are kept. */
+std::vector<input_t> Run::getCountsStream(const std::function <input_t (input_t)>& expr,
+										  const std::function <bool (input_t)>& selection)
+{
+	std::vector<input_t> chunk;
+	std::vector<input_t> transformed;
+	while(stream->next(chunk)) {
+		for(auto it = chunk.begin(); it < chunk.end(); it++) {
+			if(selection(*it)) {
+				transformed.push_back(expr(*it));
+			}
+		}
+	}
+	return transformed;
+}
+
+/* Feed every event of the stream to a batched scan */
+void Run::scanCountsStream(EventScan& scan) {
+	std::vector<input_t> chunk;
+	while(stream->next(chunk)) {
+		for(auto it = chunk.begin(); it < chunk.end(); it++) {
+			scan.push(*it);
+		}
+	}
+}
+
+/* Build a histogram in two passes over the stream, the first for the range
+ * and the second to fill it. */
+TH1D Run::getHistStream(const std::function <double (input_t)>& expr,
+						const std::function <bool (input_t)>& selection)
+{
+	std::vector<input_t> chunk;
+	double min = 0.0;
+	double max = 0.0;
+	double x;
+	bool found = false;
+
+	/* first pass to find the range of our expression */
+	while(stream->next(chunk)) {
+		for(auto it = chunk.begin(); it < chunk.end(); it++) {
+			if(!selection(*it)) {
+				continue;
+			}
+			x = expr(*it);
+			if(!found || x < min) { min = x; }
+			if(!found || x > max) { max = x; }
+			found = true;
+		}
+	}
+
+	/* close with an empty histogram if nothing was selected */
+	if(!found) {
+		TH1D hist("Empty_histo", "Empty_histo", 0, 0, 0);
+		hist.SetDirectory(0);
+		return hist;
+	}
+
+	/* second pass to fill, binned like fillUnitHist */
+	double low = floor(min);
+	double high = ceil(max);
+	if(high <= low) {
+		high = low + 1.0;
+	}
+	FastHist hist("histo", "histo", high - low, low, high);
+	stream->rewind();
+	while(stream->next(chunk)) {
+		for(auto it = chunk.begin(); it < chunk.end(); it++) {
+			if(selection(*it)) {
+				hist.fill(expr(*it));
+			}
+		}
+	}
+	return hist.toTH1D();
+}
+
+/* Same search as getTagBitEvt, but over the stream. We keep the previous
+ * event and the edge we are checking for stability, so nothing has to be
+ * kept across chunks. */
+double Run::getTagBitEvtStream(int mask, double offset, bool edge) {
+	std::vector<input_t> chunk;
+	input_t prev;
+	double edgeTime = 0.0;
+	bool armed = false;
+	long i = -1;
+
+	while(stream->next(chunk)) {
+		for(auto it = chunk.begin(); it < chunk.end(); it++) {
+			i++;
+			bool high = ((*it).tag & mask) != 0;
+
+			/* check that the edge we found is consistent for >0.2s */
+			if(armed) {
+				if((*it).realtime - edgeTime > 0.2) {
+					return edgeTime;
+				}
+				/* keep searching if there's a problem */
+				if(high != edge) {
+					armed = false;
+				}
+			}
+
+			/* look for a new edge after our offset, ignoring the first
+			 * two data points */
+			if(!armed && i > 2 && (*it).realtime > offset) {
+				bool prevHigh = (prev.tag & mask) != 0;
+				if(high == edge && prevHigh != edge) {
+					armed = true;
+					edgeTime = (*it).realtime;
+				}
+			}
+			prev = *it;
+		}
+	}
+	return -1.0;
+}
@@ -1,4 +1,9 @@
 #include "../inc/Run.hpp"
+#include "../inc/EventStream.hpp"
+#include "../inc/EventStore.hpp"
+#include "TROOT.h"
+#include "Math/MinimizerOptions.h"
+#include <mutex>
 
 /*------------------------------------------------------------------------
    Author: Nathan B. Callahan
@@ -8,6 +13,14 @@
    histograms representing the coincidence events of our analysis sims.
 ------------------------------------------------------------------------*/
 
+/* 0 means load whole runs into memory; anything else is the streaming budget */
+size_t Run::defaultMemoryBudget = 0;
+
+/* keep loaded runs as vectors of input_t unless asked to pack them */
+bool Run::compactStorage = false;
+int Run::coincThreads = 1;
+thread_local int Run::threadCoincThreads = 0;
+
 /* Load a run to create the pmt waveforms. Requires windows, sums, names, modes. */
 Run::Run(int coincWindow, int peSumWindow, int peSum, const char* fName, int coincMode) {
 	
@@ -21,19 +34,27 @@ Run::Run(int coincWindow, int peSumWindow, int peSum, const char* fName, int coi
 	runNo = -1;
 	
 	/* load/clear the new file and required trees. */
-	strcpy(fileName, fName);
+	sourceTree = "default";
 	dataFile = NULL;
 	clUp = 0.0;
 	
 	/* load our data from file */
 	dataFile = new TFile(fName, "read");
+	ownsFile = true;
 	fileName = strdup(fName);
 	dataTree = NULL;
 	coincTree = NULL;
 	
+	/* stream the run in chunks if we were given a memory budget */
+	memoryBudget = defaultMemoryBudget;
+	stream = NULL;
+	store = NULL;
+	
 	/* output of our summed waveforms */
-	pmt1SummedWaveform = TH1D("ch1SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
-	pmt2SummedWaveform = TH1D("ch2SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	pmt1SummedWaveform = FastHist("ch1SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	pmt2SummedWaveform = FastHist("ch2SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	phsA = FastHist("phsA", "phsA", 100, 0, 100);
+	phsB = FastHist("phsB", "phsB", 100, 0, 100);
 }
 
 /* Load a run to create the pmt waveforms. Here we're creating an arbitrary
@@ -50,6 +71,7 @@ Run::Run(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode,
 	/* allocate memory and initialize file/trees */
 	fileName = new char[256];
 	sprintf(fileName, runBody.c_str(), runNo);
+	sourceTree = "default";
 	
 	/* clean the trees */
 	dataFile = NULL;
@@ -57,14 +79,20 @@ Run::Run(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode,
 	
 	/* load our data from file */
 	dataFile = new TFile(fileName, "read");
+	ownsFile = true;
 	dataTree = NULL;
 	coincTree = NULL;
 	
+	/* stream the run in chunks if we were given a memory budget */
+	memoryBudget = defaultMemoryBudget;
+	stream = NULL;
+	store = NULL;
+	
 	/* output of our summed waveforms, both in the pmts and in general. */
-	pmt1SummedWaveform = TH1D("ch1SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
-	pmt2SummedWaveform = TH1D("ch2SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
-	phsA = TH1D("phsA", "phsA", 100, 0, 100);
-	phsB = TH1D("phsB", "phsB", 100, 0, 100);
+	pmt1SummedWaveform = FastHist("ch1SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	pmt2SummedWaveform = FastHist("ch2SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	phsA = FastHist("phsA", "phsA", 100, 0, 100);
+	phsB = FastHist("phsB", "phsB", 100, 0, 100);
 }
 
 /* Load a run to create our pmt and our general waveforms. Now we also 
@@ -81,6 +109,7 @@ Run::Run(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode,
 	/* allocate memory and initialize file/trees */
 	fileName = new char[256];
 	sprintf(fileName, runBody.c_str(), runNo);
+	sourceTree = namecycle;
 	
 	/* clean the trees */
 	dataFile = NULL;
@@ -88,20 +117,33 @@ Run::Run(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode,
 	
 	/* load our data from file */
 	dataFile = new TFile(fileName, "read");
+	ownsFile = true;
 	dataTree = NULL;
 	coincTree = NULL;
 	
+	/* stream the run in chunks if we were given a memory budget */
+	memoryBudget = defaultMemoryBudget;
+	stream = NULL;
+	store = NULL;
+	
 	/* output of our summed waveforms, both in the pmts and in general. */
-	pmt1SummedWaveform = TH1D("ch1SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
-	pmt2SummedWaveform = TH1D("ch2SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
-	phsA = TH1D("phsA", "phsA", 100, 0, 100);
-	phsB = TH1D("phsB", "phsB", 100, 0, 100);
+	pmt1SummedWaveform = FastHist("ch1SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	pmt2SummedWaveform = FastHist("ch2SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	phsA = FastHist("phsA", "phsA", 100, 0, 100);
+	phsB = FastHist("phsB", "phsB", 100, 0, 100);
 	
-	/* check to read our data into manipulatable root tree */
-	this->readDataRoot(namecycle);
-	if(data.empty()) {
-		input_t blank;
-		data.push_back(blank);
+	/* check to read our data into manipulatable root tree. When streaming
+	 * we only check that the tree can be streamed and read it later. */
+	if(memoryBudget > 0) {
+		streamTree = namecycle;
+	}
+	if(!this->openStream()) {
+		this->readDataRoot(namecycle);
+		if(data.empty()) {
+			input_t blank;
+			data.push_back(blank);
+		}
+		this->packData();
 	}
 }
 
@@ -119,25 +161,77 @@ Run::Run(int coincWindow, int peSumWindow, int peSum, std::vector<input_t> cts,
 	clUp = 0.0;
 	fileName = NULL;
 	dataFile = NULL;
+	ownsFile = true;
 	dataTree = NULL;
 	coincTree = NULL;
+	stream = NULL;
+	store = NULL;
 	
-	/* load our input data */
+	/* load our input data. It's already in memory so never stream. Sort it
+	 * like readDataRoot does, since the time range queries binary search it.
+	 * Events at the same time keep the order they were given in. */
 	data = cts;
+	std::stable_sort(data.begin(), data.end(), [](input_t x, input_t y)->bool{return (x.realtime < y.realtime);});
+	memoryBudget = 0;
+	this->packData();
 	
 	/* output of our summed waveforms */
-	pmt1SummedWaveform = TH1D("ch1SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
-	pmt2SummedWaveform = TH1D("ch2SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
-	phsA = TH1D("phsA", "phsA", 100, 0, 100);
-	phsB = TH1D("phsB", "phsB", 100, 0, 100);
+	pmt1SummedWaveform = FastHist("ch1SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	pmt2SummedWaveform = FastHist("ch2SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	phsA = FastHist("phsA", "phsA", 100, 0, 100);
+	phsB = FastHist("phsB", "phsB", 100, 0, 100);
+}
+
+/* Build a run around events that were already read from a file someone
+ * else owns (see MultiTreeRun). The events are moved in, not copied. */
+Run::Run(int coincWindow, int peSumWindow, int peSum, int runNo, int coincMode, TFile* sharedFile, const char* treeName, std::vector<input_t>& events) {
+	
+	/* save the input data into a tree (this) */
+	this->coincWindow = coincWindow;
+	this->peSumWindow = peSumWindow;
+	this->peSum = peSum;
+	this->runNo = runNo;
+	this->coincMode = coincMode;
+	
+	/* we share the file, so don't close it when we're done */
+	fileName = strdup(sharedFile->GetName());
+	sourceTree = treeName;
+	dataFile = sharedFile;
+	ownsFile = false;
+	clUp = 0.0;
+	dataTree = NULL;
+	coincTree = NULL;
+	stream = NULL;
+	store = NULL;
+	memoryBudget = 0;
+	
+	/* take over the events */
+	data.swap(events);
+	if(data.empty()) {
+		input_t blank;
+		data.push_back(blank);
+	}
+	this->packData();
+	
+	/* output of our summed waveforms, both in the pmts and in general. */
+	pmt1SummedWaveform = FastHist("ch1SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	pmt2SummedWaveform = FastHist("ch2SummedWaveform", "Arrival time of photons in coincidence events", 50000,0,40000);
+	phsA = FastHist("phsA", "phsA", 100, 0, 100);
+	phsB = FastHist("phsB", "phsB", 100, 0, 100);
 }
 
 /* Destructor to clear Run data (saves memory)*/ 
 Run::~Run() {
+	if(stream != NULL) {
+		delete stream;
+	}
+	if(store != NULL) {
+		delete store;
+	}
 	if(fileName != NULL) {
 		delete fileName;
 	}
-	if(dataFile != NULL) {
+	if(dataFile != NULL && ownsFile) {
 		delete dataFile;
 	}
 	if(dataTree != NULL) {
@@ -162,7 +256,7 @@ TH1D Run::getpmt1Waveform() {
 			this->findcoincidenceMoving();
 		}
 	}
-	return pmt1SummedWaveform;
+	return pmt1SummedWaveform.toTH1D();
 }
 TH1D Run::getpmt2Waveform() {
 	if(coinc.empty()) {
@@ -173,7 +267,7 @@ TH1D Run::getpmt2Waveform() {
 			this->findcoincidenceMoving();
 		}
 	}
-	return pmt2SummedWaveform;
+	return pmt2SummedWaveform.toTH1D();
 }
 
 /* Histograms that contain the waveform for each position. */
@@ -186,7 +280,7 @@ TH1D Run::getphsA() {
 			this->findcoincidenceMoving();
 		}
 	}
-	return phsA;
+	return phsA.toTH1D();
 }
 TH1D Run::getphsB() {
 	if(coinc.empty()) {
@@ -197,7 +291,7 @@ TH1D Run::getphsB() {
 			this->findcoincidenceMoving();
 		}
 	}
-	return phsB;
+	return phsB.toTH1D();
 }
 
 /* Find the run number for our file */
@@ -208,37 +302,29 @@ int Run::getRunNo() {
 //----------------------------------------------------------------------
 /* Choose some parameters of the run cycle. We reset the counters each
  * time and then set the value we want. */
-void Run::setCoincWindow(int window) {
-	coincWindow = window;
+void Run::clearCoinc() {
 	coinc.clear();
 	pmtACoincHits.clear();
 	pmtBCoincHits.clear();
-	pmt1SummedWaveform.Reset();
-	pmt2SummedWaveform.Reset();
+	copiedHits.clear();
+	pmt1SummedWaveform.reset();
+	pmt2SummedWaveform.reset();
+}
+void Run::setCoincWindow(int window) {
+	coincWindow = window;
+	this->clearCoinc();
 }
 void Run::setPeSumWindow(int window) {
 	peSumWindow = window;
-	coinc.clear();
-	pmtACoincHits.clear();
-	pmtBCoincHits.clear();
-	pmt1SummedWaveform.Reset();
-	pmt2SummedWaveform.Reset();
+	this->clearCoinc();
 }
 void Run::setPeSum(int sum) {
 	peSum = sum;
-	coinc.clear();
-	pmtACoincHits.clear();
-	pmtBCoincHits.clear();
-	pmt1SummedWaveform.Reset();
-	pmt2SummedWaveform.Reset();
+	this->clearCoinc();
 }
 void Run::setCoincMode(int mode) {
 	coincMode = mode;
-	coinc.clear();
-	pmtACoincHits.clear();
-	pmtBCoincHits.clear();
-	pmt1SummedWaveform.Reset();
-	pmt2SummedWaveform.Reset();
+	this->clearCoinc();
 }
 
 //----------------------------------------------------------------------
@@ -256,6 +342,64 @@ int Run::getCoincMode() {
 	return coincMode;
 }
 
+/* Set the memory budget (in bytes) for Runs built after this call. With a
+ * budget the run is streamed in time order in chunks instead of being
+ * loaded into data. 0 turns streaming off. */
+void Run::setMemoryBudget(size_t bytes) {
+	defaultMemoryBudget = bytes;
+}
+
+/* Pack runs loaded after this call into an EventStore (about half the
+ * memory) instead of keeping them as vectors of input_t. */
+void Run::setCompactStorage(bool compact) {
+	compactStorage = compact;
+}
+
+/* Search loaded runs for coincidences on this many threads. 1 searches
+ * serially and 0 uses every core. The results are the same either way. */
+void Run::setCoincThreads(int threads) {
+	coincThreads = threads;
+}
+
+/* Override setCoincThreads for the Runs searched on the calling thread, e.g.
+ * one thread each when the runs themselves are spread over threads. 0 goes
+ * back to setCoincThreads. Returns the override it replaced. */
+int Run::setThreadCoincThreads(int threads) {
+	int previous = threadCoincThreads;
+	threadCoincThreads = threads;
+	return previous;
+}
+
+/* Get ROOT ready for Runs to be built and analyzed on several threads at
+ * once: ROOT's own locks on, new histograms kept out of the shared current
+ * directory, and fits done with Minuit2, which has no global state like 
+ * TMinuit. Call it once at startup, before any threads. */
+void Run::initThreadSafety() {
+	static std::once_flag once;
+	std::call_once(once, []() {
+		ROOT::EnableThreadSafety();
+		TH1::AddDirectory(kFALSE);
+		ROOT::Math::MinimizerOptions::SetDefaultMinimizer("Minuit2");
+	});
+}
+
+/* Read and decode the run now instead of on its first query, e.g. ahead of
+ * time on a prefetch thread. Runs made from events in memory have no file
+ * to read, and streamed runs are read as they are walked, so there's nothing
+ * to do for either. */
+bool Run::preload() {
+	if(dataFile == NULL) {
+		return this->loadData();
+	}
+	if(!this->exists()) {
+		return false;
+	}
+	if(memoryBudget > 0 && data.empty() && store == NULL) {
+		return true;
+	}
+	return this->loadData();
+}
+
 /* Check to make sure the run actually loads normally */
 bool Run::exists() {
 	return(!dataFile->IsZombie());
@@ -0,0 +1,72 @@
+#include "../inc/RunPrefetcher.hpp"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Look-ahead run loading on a background thread. See RunPrefetcher.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Start loading the first depth runs right away */
+RunPrefetcher::RunPrefetcher(long numRuns, int depth, const std::function <Run* (long)>& open) {
+	this->numRuns = numRuns;
+	this->depth = depth > 0 ? depth : 1;
+	this->open = open;
+	numTaken = 0;
+	stopping = false;
+	Run::initThreadSafety();
+	loader = std::thread(&RunPrefetcher::loadRuns, this);
+}
+
+/* Stop the loader and free anything that was never taken */
+RunPrefetcher::~RunPrefetcher() {
+	{
+		std::lock_guard<std::mutex> lock(queueLock);
+		stopping = true;
+	}
+	queueChanged.notify_all();
+	loader.join();
+	for(auto it = ready.begin(); it < ready.end(); it++) {
+		delete *it;
+	}
+}
+
+/* The loader thread: build and read each run in turn, as long as there is
+ * room in the queue */
+void RunPrefetcher::loadRuns() {
+	long k;
+	for(k = 0; k < numRuns; k++) {
+		{
+			std::unique_lock<std::mutex> lock(queueLock);
+			queueChanged.wait(lock, [this]() { return stopping || (int)ready.size() < depth; });
+			if(stopping) {
+				return;
+			}
+		}
+
+		/* the slow part, done without holding the queue */
+		Run* run = open(k);
+		run->preload();
+
+		std::lock_guard<std::mutex> lock(queueLock);
+		if(stopping) {
+			delete run;
+			return;
+		}
+		ready.push_back(run);
+		queueChanged.notify_all();
+	}
+}
+
+/* The next run, in order, once it's loaded. NULL when there are no more. */
+Run* RunPrefetcher::next() {
+	std::unique_lock<std::mutex> lock(queueLock);
+	if(numTaken >= numRuns) {
+		return NULL;
+	}
+	queueChanged.wait(lock, [this]() { return !ready.empty(); });
+	Run* run = ready.front();
+	ready.pop_front();
+	numTaken++;
+	queueChanged.notify_all();
+	return run;
+}
@@ -0,0 +1,87 @@
+#include "../inc/RunScheduler.hpp"
+#include <algorithm>
+#include <thread>
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Biggest-first, work-stealing job pool. See RunScheduler.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* 0 threads means one per core */
+RunScheduler::RunScheduler(int numThreads) {
+	this->numThreads = numThreads > 0 ? numThreads : (int)std::thread::hardware_concurrency();
+	if(this->numThreads < 1) {
+		this->numThreads = 1;
+	}
+}
+
+int RunScheduler::getNumThreads() {
+	return numThreads;
+}
+
+/* Pick the next job for a thread: the front of its own queue, or failing
+ * that the back of the longest queue. Returns false when there are none. */
+bool RunScheduler::takeJob(int thread, long& job) {
+	std::lock_guard<std::mutex> lock(queueLock);
+	if(!queues[thread].empty()) {
+		job = queues[thread].front();
+		queues[thread].pop_front();
+		return true;
+	}
+	int victim = -1;
+	int i;
+	for(i = 0; i < (int)queues.size(); i++) {
+		if(!queues[i].empty() && (victim < 0 || queues[i].size() > queues[victim].size())) {
+			victim = i;
+		}
+	}
+	if(victim < 0) {
+		return false;
+	}
+	job = queues[victim].back();
+	queues[victim].pop_back();
+	return true;
+}
+
+/* Do job(k) for every job, biggest cost first, on our threads */
+void RunScheduler::run(const std::vector<double>& costs, const std::function <void (long)>& job) {
+	long numJobs = costs.size();
+	long k;
+	if(numThreads <= 1 || numJobs <= 1) {
+		for(k = 0; k < numJobs; k++) {
+			job(k);
+		}
+		return;
+	}
+
+	/* sort the jobs biggest first (ties in their own order) and deal them
+	 * out to the threads */
+	std::vector<long> order(numJobs);
+	for(k = 0; k < numJobs; k++) {
+		order[k] = k;
+	}
+	std::stable_sort(order.begin(), order.end(), [&costs](long a, long b)->bool{
+		return costs[a] > costs[b];
+	});
+	int usedThreads = (int)std::min((long)numThreads, numJobs);
+	queues.assign(usedThreads, std::deque<long>());
+	for(k = 0; k < numJobs; k++) {
+		queues[k % usedThreads].push_back(order[k]);
+	}
+
+	/* each thread works until there is nothing left to take */
+	std::vector<std::thread> threads;
+	int t;
+	for(t = 0; t < usedThreads; t++) {
+		threads.push_back(std::thread([this, t, &job]() {
+			long next;
+			while(this->takeJob(t, next)) {
+				job(next);
+			}
+		}));
+	}
+	for(auto it = threads.begin(); it < threads.end(); it++) {
+		(*it).join();
+	}
+}
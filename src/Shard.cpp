@@ -0,0 +1,250 @@
+#include "../inc/Shard.hpp"
+#include <algorithm>
+#include <string.h>
+#include "TFile.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TH1.h"
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Splitting a campaign into shards and merging their outputs. See Shard.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* one line of a shard's tables, and where it goes in the merged tables */
+struct shardLine {
+	int kind;
+	long position;
+	std::string text;
+};
+
+#define SHARDRUNLINE 0
+#define SHARDMEASUREMENTLINE 1
+
+/* The whole campaign */
+Shard::Shard() {
+	index = 0;
+	count = 1;
+}
+
+Shard::Shard(int index, int count) {
+	this->index = index;
+	this->count = count;
+}
+
+/* Read a shard written i/N. Returns false (and changes nothing) if it isn't one. */
+bool Shard::parse(const char* spec) {
+	int i, n;
+	char extra;
+	if(spec == NULL || sscanf(spec, "%d/%d%c", &i, &n, &extra) != 2 || n < 1 || i < 0 || i >= n) {
+		fprintf(stderr, "Error! Shard \"%s\" isn't i/N with 0 <= i < N!\n", spec == NULL ? "" : spec);
+		return false;
+	}
+	index = i;
+	count = n;
+	return true;
+}
+
+/* Runs go to shard runNo mod N */
+bool Shard::owns(int runNo) {
+	return ((runNo % count) + count) % count == index;
+}
+
+bool Shard::isWhole() {
+	return count == 1;
+}
+
+int Shard::getIndex() {
+	return index;
+}
+
+int Shard::getCount() {
+	return count;
+}
+
+/* Tag the start of a shard's log */
+void Shard::printHeader() {
+	if(this->isWhole()) {
+		return;
+	}
+	printf("Shard - %d/%d\n", index, count);
+}
+
+/* Tag the start of each run, by its place in the full list */
+void Shard::printRun(long position, int runNo) {
+	if(this->isWhole()) {
+		return;
+	}
+	printf("ShardRun - %ld,%d\n", position, runNo);
+}
+
+/* Write out a measurement so the measurement vector can be put back together */
+void Shard::printMeasurement(long position, int runNo, measurement result) {
+	if(this->isWhole()) {
+		return;
+	}
+	printf("Measurement - %ld,%d,%.17g,%.17g\n", position, runNo, result.val, result.err);
+}
+
+/* Put the tables in the logs of all N shards back in the order of the full
+ * run list and write them to out. Fails if the logs aren't exactly one of
+ * each shard, or two shards claim the same run. */
+bool Shard::mergeTables(const std::vector<std::string>& logNames, FILE* out) {
+	std::vector<shardLine> lines;
+	std::vector<char> seen;
+	std::vector<long> runPositions;
+	int count = 0;
+	char* text = NULL;
+	size_t textSize = 0;
+	size_t f;
+	for(f = 0; f < logNames.size(); f++) {
+		FILE* log = fopen(logNames[f].c_str(), "r");
+		if(log == NULL) {
+			fprintf(stderr, "Error! Can't open shard log %s!\n", logNames[f].c_str());
+			free(text);
+			return false;
+		}
+
+		int index = -1;
+		long position = -1;
+		ssize_t len;
+		while((len = getline(&text, &textSize, log)) >= 0) {
+			while(len > 0 && (text[len-1] == '\n' || text[len-1] == '\r')) {
+				text[--len] = '\0';
+			}
+			int i, n;
+			long k;
+			int runNo;
+			if(!strncmp(text, "Shard - ", 8) && sscanf(text + 8, "%d/%d", &i, &n) == 2) {
+				if(index >= 0 || n < 1 || i < 0 || i >= n || (count > 0 && n != count)) {
+					fprintf(stderr, "Error! %s has a bad or second shard header \"%s\"!\n", logNames[f].c_str(), text);
+					fclose(log);
+					free(text);
+					return false;
+				}
+				if(count == 0) {
+					count = n;
+					seen.assign(n, 0);
+				}
+				if(seen[i]) {
+					fprintf(stderr, "Error! Shard %d/%d was given twice (again in %s)!\n", i, n, logNames[f].c_str());
+					fclose(log);
+					free(text);
+					return false;
+				}
+				seen[i] = 1;
+				index = i;
+			}
+			else if(!strncmp(text, "ShardRun - ", 11) && sscanf(text + 11, "%ld,%d", &k, &runNo) == 2) {
+				position = k;
+				runPositions.push_back(k);
+			}
+			else if(!strncmp(text, "Measurement - ", 14) && sscanf(text + 14, "%ld", &k) == 1) {
+				lines.push_back(shardLine {SHARDMEASUREMENTLINE, k, std::string(text)});
+			}
+			else if(!strncmp(text, "Data - ", 7) || !strncmp(text, "FillData - ", 11)) {
+				lines.push_back(shardLine {SHARDRUNLINE, position, std::string(text)});
+			}
+		}
+		fclose(log);
+		if(index < 0) {
+			fprintf(stderr, "Error! %s has no shard header (Shard - i/N)!\n", logNames[f].c_str());
+			free(text);
+			return false;
+		}
+	}
+	free(text);
+
+	/* every shard, and every run only once */
+	if(count == 0 || (int)logNames.size() != count) {
+		fprintf(stderr, "Error! Got %ld shard logs for %d shards!\n", (long)logNames.size(), count);
+		return false;
+	}
+	std::sort(runPositions.begin(), runPositions.end());
+	if(std::adjacent_find(runPositions.begin(), runPositions.end()) != runPositions.end()) {
+		fprintf(stderr, "Error! Two shards did the same run!\n");
+		return false;
+	}
+
+	/* the runs' lines in run order, then the measurements in run order. Lines
+	 * of the same run keep the order they were printed in. */
+	std::stable_sort(lines.begin(), lines.end(), [](const shardLine& a, const shardLine& b)->bool{
+		return a.kind != b.kind ? a.kind < b.kind : a.position < b.position;
+	});
+	for(auto it = lines.begin(); it < lines.end(); it++) {
+		fprintf(out, "%s\n", it->text.c_str());
+	}
+	return true;
+}
+
+/* Add up the histograms of the same name in each of the shards' ROOT files
+ * and write the sums to outName. */
+bool Shard::mergeHistograms(const std::vector<std::string>& fileNames, const char* outName) {
+	std::vector<TH1*> sums;
+	bool good = true;
+	size_t f;
+	for(f = 0; f < fileNames.size() && good; f++) {
+		TFile inFile(fileNames[f].c_str(), "READ");
+		if(inFile.IsZombie()) {
+			fprintf(stderr, "Error! Can't open shard file %s!\n", fileNames[f].c_str());
+			good = false;
+			break;
+		}
+		TIter next(inFile.GetListOfKeys());
+		TKey* key;
+		while((key = (TKey*)next()) != NULL) {
+
+			/* only the last cycle of each name */
+			TKey* latest = inFile.GetKey(key->GetName());
+			if(latest != NULL && latest->GetCycle() != key->GetCycle()) {
+				continue;
+			}
+			TObject* obj = key->ReadObj();
+			TH1* hist = dynamic_cast<TH1*>(obj);
+			if(hist == NULL) {
+				delete obj;
+				continue;
+			}
+			hist->SetDirectory(0);
+
+			auto sum = std::find_if(sums.begin(), sums.end(), [hist](TH1* h)->bool{
+				return !strcmp(h->GetName(), hist->GetName());
+			});
+			if(sum == sums.end()) {
+				sums.push_back(hist);
+				continue;
+			}
+			if((*sum)->GetNbinsX() != hist->GetNbinsX()
+				|| (*sum)->GetXaxis()->GetXmin() != hist->GetXaxis()->GetXmin()
+				|| (*sum)->GetXaxis()->GetXmax() != hist->GetXaxis()->GetXmax()) {
+				fprintf(stderr, "Error! Histogram %s in %s is binned differently than in the other shards!\n", hist->GetName(), fileNames[f].c_str());
+				delete hist;
+				good = false;
+				break;
+			}
+			(*sum)->Add(hist);
+			delete hist;
+		}
+		inFile.Close();
+	}
+
+	if(good) {
+		TFile outFile(outName, "RECREATE");
+		if(outFile.IsZombie()) {
+			fprintf(stderr, "Error! Can't write %s!\n", outName);
+			good = false;
+		}
+		else {
+			outFile.cd();
+			for(auto it = sums.begin(); it < sums.end(); it++) {
+				(*it)->Write();
+			}
+			outFile.Close();
+		}
+	}
+	for(auto it = sums.begin(); it < sums.end(); it++) {
+		delete *it;
+	}
+	return good;
+}
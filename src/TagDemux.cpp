@@ -0,0 +1,202 @@
+#include "../inc/TagDemux.hpp"
+
+#define NANOSECOND .000000001
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Nathan B. Callahan (?)
+	Editor: Frank M. Gonzalez
+
+	Tag bit demultiplexing for the mcs_events trees, pulled out of readDataRoot. See TagDemux.hpp.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Start with nothing decoded */
+TagDemux::TagDemux(std::vector<input_t>& out, DeadtimeVeto& veto) : out(out), veto(veto) {
+	numRead = 0;
+	haveGroup3 = false;
+	haveGroup4 = false;
+}
+
+int TagDemux::numBits(uint32_t i)
+{
+     /* Didn't come up with this, I assume it's magic. */
+     i = i - ((i >> 1) & 0x55555555);
+     i = (i & 0x33333333) + ((i >> 2) & 0x33333333);
+     return (((i + (i >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+/* Number of raw events pushed so far */
+long TagDemux::getNumRead() {
+	return numRead;
+}
+
+/* Put a decoded event through the deadtime veto and, if it makes it into
+ * the output, update the lookbacks */
+void TagDemux::append(input_t event) {
+	if(!veto.push(event, out)) {
+		return;
+	}
+	if(event.ch > 5 || event.ch == 3) {
+		lastGroup3 = event;
+		haveGroup3 = true;
+	}
+	if(event.ch > 9 || event.ch == 4) {
+		lastGroup4 = event;
+		haveGroup4 = true;
+	}
+}
+
+/* Decode one raw event */
+void TagDemux::push(input_t event) {
+	numRead++;
+
+	/* check if the event is in  channel 3. If so we need to find
+	 * how many tags we have on it. */
+	if(event.ch == 3) {
+		uint32_t tag = event.tag & (0x7800);
+		int numTags = numBits(tag);
+		bool close = haveGroup3 && (event.realtime - lastGroup3.realtime) < 1000*NANOSECOND;
+		/* check for 3+ tag events */
+		if(numTags > 2) {
+			printf("Found 3 tag event!\n");
+			/* if we find a close event, it's probably one of the
+			 * defining tag bit events. */
+			if(close) {
+				/* map out previous bit */
+				tag = tag ^ lastGroup3.tag;
+			}
+			else {
+				return;
+			}
+		}
+		/* check for 0 tag events */
+		else if(numTags == 0) {
+			/* if we find a close event, it's probably the event that
+			 * defines half of the tag bit */
+			if(close) {
+				/* makes current tag the same as the previous event */
+				tag = (1 << (lastGroup3.ch+5));
+			}
+		}
+		/* check for 2 tag events */
+		else if(numTags == 2) {
+			/* if this was a double followed by a double, then
+			 * break them out and assign one channel to each. */
+			if(close && numBits(lastGroup3.tag & (0x7800)) == 2) {
+				return;
+			}
+			/* if we find an event in close proximity, it's probably
+			 * the event which defines half of the tag bit */
+			else if(close) {
+				/* map out previous bit */
+				tag = tag ^ (1 << (lastGroup3.ch+5));
+			}
+			/* if nothing else works, we can just loop around channels */
+			else {
+				int t = 11;
+				while(!(tag & (1<<t))) {
+					t++;
+				}
+				event.ch = t - 5;
+				this->append(event);
+				tag = (tag ^ (1<<t));
+			}
+		}
+		/* use the tag to find which channel we're in */
+		switch(tag) {
+			case (1 << 11) :
+				event.ch = 6;
+				break;
+			case (1 << 12) :
+				event.ch = 7;
+				break;
+			case (1 << 13) :
+				event.ch = 8;
+				break;
+			case (1 << 14) :
+				event.ch = 9;
+				break;
+			case 0:
+				printf("Found 0 Tag event with no previous event within Gate Window!\n");
+			default :
+				break;
+		}
+	}
+	/* check what happens in channel 4 */
+	if(event.ch == 4) {
+		uint32_t tag = event.tag & (0x600);
+		int numTags = numBits(tag);
+		bool close = haveGroup4 && (event.realtime - lastGroup4.realtime) < 1000*NANOSECOND;
+		if(numTags > 2) {
+			printf("Found 3 tag event!\n");
+			/* If we find an event in close proximity, it's probably
+			 * the event which defines half of the tag bit. */
+			if(close) {
+				/* map out the previous bit */
+				tag = tag ^ lastGroup4.tag;
+			}
+			else {
+				return;
+			}
+		}
+		else if(numTags == 0) {
+			/* If we find an event in close proximity, it's probably
+			 * the event which defines half of the tag bit. */
+			if(close) {
+				/* make current tag same as previous event */
+				tag = (1 << (lastGroup4.ch-1));
+			}
+		}
+		else if(numTags == 2) {
+			/* If this was a double followed by a double, then
+			 * break them out and assign one channel to each */
+			if(close && numBits(lastGroup4.tag & (0x600)) == 2) {
+				return;
+			}
+			/* If we find an event in close proximity, it's probably
+			 * the event which defines half of the tag bit. */
+			else if(close) {
+				/* map out previous bit */
+				tag = tag ^ (1 << (lastGroup4.ch-1));
+			}
+			else {
+				/* if the event is outside, then scan and put into
+				 * tag bits */
+				int t = 9;
+				while(!(tag & (1<<t))) {
+					t++;
+				}
+				event.ch = t + 1;
+				this->append(event);
+				tag = (tag ^ (1<<t));
+			}
+		}
+		/* hardcode in channels for other tags */
+		switch(tag) {
+			case (1 << 9) :
+				event.ch = 10;
+				break;
+			case (1 << 10) :
+				event.ch = 11;
+				break;
+			case 0:
+				printf("Found 0 Tag event with no previous event within Gate Window!\n");
+			default :
+				break;
+		}
+	}
+	this->append(event);
+}
+
+/* Decode a block of raw events, in tree order. Most events are PMT hits
+ * (ch0-ch2) that don't take part in any lookback, so they go straight to
+ * the veto. */
+void TagDemux::push(const std::vector<input_t>& block) {
+	for(auto it = block.begin(); it < block.end(); it++) {
+		if((*it).ch < 3) {
+			numRead++;
+			veto.push(*it, out);
+			continue;
+		}
+		this->push(*it);
+	}
+}
@@ -0,0 +1,131 @@
+#include "../inc/TreeReader.hpp"
+#include "TROOT.h"
+#include "TTreeCacheUnzip.h"
+
+/* size of the TTreeCache we read baskets into */
+#define READCACHESIZE 67108864
+
+/*	------------------------------------------------------------------------------------------------
+	Author: Frank M. Gonzalez
+
+	Block reader for the MCS event trees. See TreeReader.hpp for how it's used.
+	------------------------------------------------------------------------------------------------	*/
+
+/* Set up the leaves and the read cache for a tree */
+TreeReader::TreeReader(TTree* tree) : clusters(tree->GetClusterIterator(0)) {
+	this->tree = tree;
+	valid = true;
+	nextEntry = 0;
+	clusterEnd = 0;
+	numEntries = tree->GetEntries();
+
+	/* load leaves into our event. The tmcs trees call the channel leaf
+	 * "channel", the older mcs_events trees call it "ch". */
+	bindLeaf("time", &event.time);
+	bindLeaf("realtime", &event.realtime);
+	if(tree->FindLeaf("channel") != NULL) {
+		bindLeaf("channel", &event.ch);
+	}
+	else {
+		bindLeaf("ch", &event.ch);
+	}
+	bindLeaf("tag", &event.tag);
+	if(!valid) {
+		return;
+	}
+
+	/* only cache the branches we actually read, and skip the learning
+	 * phase since we already know what they are */
+	tree->SetCacheSize(READCACHESIZE);
+	for(auto it = branches.begin(); it < branches.end(); it++) {
+		tree->AddBranchToCache(*it);
+	}
+	tree->StopCacheLearningPhase();
+}
+
+/* Bind one leaf to a field of our event and remember its branch */
+void TreeReader::bindLeaf(const char* name, void* address) {
+	TLeaf* leaf = tree->FindLeaf(name);
+	if(leaf == NULL) {
+		fprintf(stderr, "Error! Could not find leaf %s in tree!\n", name);
+		valid = false;
+		return;
+	}
+	leaf->SetAddress(address);
+
+	/* several leaves usually live on the same branch, only read it once */
+	TBranch* br = leaf->GetBranch();
+	if(std::find(branches.begin(), branches.end(), br) == branches.end()) {
+		branches.push_back(br);
+	}
+}
+
+/* Check that every leaf we need was found */
+bool TreeReader::isValid() {
+	return valid;
+}
+
+/* Number of entries in the tree */
+Long64_t TreeReader::getEntries() {
+	return numEntries;
+}
+
+/* Append the next cluster of events to block. Returns how many events were
+ * added, so 0 once the whole tree has been read. */
+long TreeReader::readBlock(std::vector<input_t>& block) {
+	return this->readBlock(block, numEntries);
+}
+
+/* Append at most maxEvents of the next cluster to block. What's left of the
+ * cluster comes with the next call. */
+long TreeReader::readBlock(std::vector<input_t>& block, long maxEvents) {
+	if(!valid || nextEntry >= numEntries || maxEvents <= 0) {
+		return 0;
+	}
+
+	/* step to the next cluster once we're done with this one. If the tree 
+	 * has no cluster info we still get sane boundaries from the iterator. */
+	if(nextEntry >= clusterEnd) {
+		clusters.Next();
+		clusterEnd = clusters.GetNextEntry();
+		if(clusterEnd > numEntries || clusterEnd <= nextEntry) {
+			clusterEnd = numEntries;
+		}
+	}
+	Long64_t start = nextEntry;
+	Long64_t end = std::min(clusterEnd, start + (Long64_t)maxEvents);
+
+	/* grow geometrically, so callers that didn't presize still only copy
+	 * the block a few times */
+	size_t need = block.size() + (size_t)(end - start);
+	if(block.capacity() < need) {
+		block.reserve(std::max(need, 2*block.capacity()));
+	}
+	Long64_t i;
+	for(i = start; i < end; i++) {
+		for(auto it = branches.begin(); it < branches.end(); it++) {
+			(*it)->GetEntry(i);
+		}
+		block.push_back(event);
+	}
+	nextEntry = end;
+	return (long)(end - start);
+}
+
+/* Read the whole tree onto the end of out */
+long TreeReader::readAll(std::vector<input_t>& out) {
+	long numRead = 0;
+	long n;
+	out.reserve(out.size() + numEntries);
+	while((n = this->readBlock(out)) > 0) {
+		numRead += n;
+	}
+	return numRead;
+}
+
+/* Turn on ROOT's thread pool, which the read cache uses to unzip baskets
+ * in parallel. nThreads = 0 lets ROOT pick. */
+void TreeReader::enableImplicitMT(int nThreads) {
+	ROOT::EnableImplicitMT(nThreads > 0 ? nThreads : 0);
+	TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kEnable);
+}